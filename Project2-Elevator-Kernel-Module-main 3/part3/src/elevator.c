@@ -1,25 +1,115 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <linux/kernel.h>
-#include <linux/kthread.h>
-#include <linux/delay.h>
 #include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/llist.h>
 #include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/moduleparam.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/mempool.h>
+#include <linux/atomic.h>
+#include <linux/sched/clock.h>
+#include <linux/ktime.h>
+#include <linux/timekeeping.h>
+#include <linux/bitops.h>
+#include <linux/mm.h>
+#include <linux/bitmap.h>
+#include <linux/uaccess.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/lockdep.h>
+#include <linux/rcupdate.h>
+
+#define CREATE_TRACE_POINTS
+#include "elevator_trace.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("cop4610t- Group 3");
 MODULE_DESCRIPTION("Kernel module for our groups elevator");
 
 #define ENTRY_NAME "elevator"
+#define STATS_ENTRY_NAME "elevator_stats"
+#define EVENTS_ENTRY_NAME "elevator_events"
+#define PARKING_ENTRY_NAME "elevator_parking"
+#define DEVICE_NAME "elevator"
 #define PERMS 0644
 #define PARENT NULL
 
+// upper bound for num_floors
+#define MAX_FLOORS 256
+
+// issue_requests() accepts up to ISSUE_BATCH_MAX entries per call and copies
+// them from userspace ISSUE_CHUNK at a time
+#define ISSUE_BATCH_MAX 4096
+#define ISSUE_CHUNK 64
+
+// /dev/elevator rings hold ring_entries requests, a power of two up to
+// RING_ENTRIES_MAX, and at most RINGS_MAX are open at once. The kernel sets
+// ELEVATOR_RING_NEED_WAKEUP in the ring header while no car is polling, then
+// new requests need the doorbell.
+#define RING_ENTRIES_MAX 65536
+#define RINGS_MAX 64
+#define ELEVATOR_RING_NEED_WAKEUP 1
+#define ELEVATOR_IOC_DOORBELL _IO('E', 0)
+
+// /proc/elevator_events keeps the last event_entries events, a power of two
+// up to EVENT_ENTRIES_MAX, and copies them out EVENT_CHUNK at a time
+#define EVENT_ENTRIES_MAX (1 << 20)
+#define EVENT_CHUNK 16
+
+// /proc/elevator lists at most this many of a floor's waiting riders, the
+// rest are counted and shown as "..."
+#define SNAPSHOT_RIDERS 64
+
+// elevator_event types, same values as in wrappers.h
+#define ELEVATOR_EVENT_STATE 1
+#define ELEVATOR_EVENT_ENQUEUE 2
+#define ELEVATOR_EVENT_BOARD 3
+#define ELEVATOR_EVENT_ALIGHT 4
+#define ELEVATOR_EVENT_OVERRUN 5
+
+// passenger types P, L, B and V, each with its own weight
+#define NUM_TYPES 4
+
+// destination grouping looks at this many riders of each type per queue
+#define GROUP_SCAN 8
+
+// trip histograms have 4 buckets per power of two microseconds, the last
+// one holding everything from about 12 days on
+#define STATS_BUCKETS 160
+
+// Idle parking learns an arrival rate per floor and hour of the day (UTC),
+// an EWMA over the days seen that weights the newest count for the hour by
+// 1 / (1 << PARKING_EWMA_SHIFT), in arrivals per hour times RATE_SCALE
+#define PARKING_BUCKETS 24
+#define PARKING_WINDOW_S 3600
+#define PARKING_EWMA_SHIFT 2
+#define RATE_SCALE 10
+
+// how much later than asked a scaled travel or dwell period may end, so
+// the hrtimer can be coalesced with others
+#define DELAY_SLACK_US 20
+
 static struct proc_dir_entry *elevator_entry;
+static struct proc_dir_entry *stats_entry;
+static struct proc_dir_entry *events_entry;
+static struct proc_dir_entry *parking_entry;
 
 extern int (*STUB_start_elevator)(void);
 extern int (*STUB_issue_request)(int, int, int);
 extern int (*STUB_stop_elevator)(void);
+extern int (*STUB_issue_requests)(const void __user *, int __user *, unsigned int);
 
 // Enumerations
 enum elevator_state
@@ -31,19 +121,135 @@ enum elevator_state
     DOWN
 };
 
+enum trip_metric
+{
+    WAIT_TIME,
+    RIDE_TIME,
+    TRIP_TIME,
+    NUM_METRICS
+};
+
 // Passenger struct
 struct Passenger
 {
     char type;
+    int type_index;
     int destination_floor;
     int starting_floor;
     int weight;
+    int car;
+    u64 id;
+    u64 seq;
+    int stops_seen;
+    ktime_t issued;
+    ktime_t boarded;
     struct list_head list;
+    struct list_head queue;
+    struct llist_node ingest;
+};
+
+// One entry of an issue_requests() batch, same layout as in wrappers.h
+struct elevator_request
+{
+    int start_floor;
+    int destination_floor;
+    int type;
+};
+
+// Start of a /dev/elevator mapping, same layout as in wrappers.h. The
+// submission ring at sq_offset is filled by userspace, which owns sq_tail
+// and cq_head; the completion ring at cq_offset by the kernel, which owns
+// sq_head and cq_tail.
+struct elevator_ring_header
+{
+    u32 sq_head;
+    u32 sq_tail;
+    u32 cq_head;
+    u32 cq_tail;
+    u32 entries;
+    u32 flags;
+    u32 sq_offset;
+    u32 cq_offset;
+};
+
+struct elevator_sqe
+{
+    int start_floor;
+    int destination_floor;
+    int type;
+    u32 user_data;
+};
+
+// status is what issue_request() would have returned, passenger_id is 0
+// for a rejected request
+struct elevator_cqe
+{
+    u32 user_data;
+    int status;
+    u64 passenger_id;
+};
+
+// One record of /proc/elevator_events, same layout as in wrappers.h. seq
+// numbers every event. value is the new state for ELEVATOR_EVENT_STATE and
+// the destination for passenger events; id is the passenger's, or for an
+// overrun the number of events the reader lost from seq on.
+struct elevator_event
+{
+    u64 timestamp_ns;
+    u64 id;
+    u32 seq;
+    u16 type;
+    u16 car;
+    u16 floor;
+    u16 value;
+    u16 passengers;
+    u16 waiting;
+};
+
+// What /proc/elevator shows of a car and of a floor, copied out at the end
+// of the step that last changed them. A snapshot is never modified once
+// published; the next one replaces it and it is freed after an RCU grace
+// period, so readers render it without taking any lock the cars take.
+struct RiderSnapshot
+{
+    char type;
+    int destination_floor;
+};
+
+struct CarSnapshot
+{
+    struct rcu_head rcu;
+    enum elevator_state state;
+    int floor;
+    int weight;
+    int assigned;
+    int num_riders;
+    struct RiderSnapshot riders[];
+};
+
+struct FloorSnapshot
+{
+    struct rcu_head rcu;
+    int num_waiting;
+    int num_riders;
+    struct RiderSnapshot riders[];
+};
+
+// A car's last parking decision, for /proc/elevator_parking. The costs are
+// the expected distance to the next caller, in hundredths of a floor, if
+// the car waits at from and if it waits at to.
+struct ParkingDecision
+{
+    int from;
+    int to;
+    u32 cost_from;
+    u32 cost_to;
 };
 
 // Elevator struct
 struct Elevator
 {
+    int id;
     enum elevator_state current_state;
     int deactivating;
     int initialized;
@@ -52,19 +258,101 @@ struct Elevator
     int num_passengers;
     int direction;
     int num_serviced;
+    int *hall_calls;
+    int *car_calls;
+    unsigned long *hall_map;
+    unsigned long *car_map;
+    struct list_head *hall_queues;
+    int *hall_stops;
+    atomic_t num_assigned;
+    int park_floor;
+    struct ParkingDecision parked;
+    u32 *park_cover;
+    struct CarSnapshot __rcu *snapshot;
     struct list_head elevator_list;
-    struct task_struct *thread;
     struct mutex elevator_mutex;
+    struct hrtimer timer;
+    struct work_struct work;
+    ktime_t due;
 };
 
-// Floors struct
+// Floors struct. floor_locks[i] guards floor_lists[i], curr_waiting[i] and
+// next_seq[i], and every car's hall calls, hall queues and hall stops for
+// that floor, so passengers on different floors are queued independently.
+// New passengers are pushed onto ingest[i] without the lock and queued by
+// whoever holds it next, so a submitter never waits for a car stopped at
+// its floor.
+//
+// Lock order: rings_mutex, ring_mutex, elevator_mutex, one floor lock,
+// then events_lock or parking_lock. Nobody holds two floor locks or two
+// cars at once.
 struct Floors
 {
     int initialized;
-    int curr_waiting[5];
-    int num_passengers_waiting;
-    struct list_head floor_lists[5];
-    struct mutex floors_mutex;
+    int *curr_waiting;
+    atomic_t num_passengers_waiting;
+    u64 *next_seq;
+    struct list_head *floor_lists;
+    struct mutex *floor_locks;
+    struct llist_head *ingest;
+    struct FloorSnapshot __rcu **snapshots;
+    unsigned long *stale_map;
+};
+
+// One open /dev/elevator and the rings it shares. The kernel works from
+// its own copies of the indices it owns, the header is writable by the
+// user.
+struct Ring
+{
+    struct elevator_ring_header *header;
+    struct elevator_sqe *sq;
+    struct elevator_cqe *cq;
+    size_t size;
+    u32 sq_head;
+    u32 cq_tail;
+    struct mutex ring_mutex;
+    struct list_head list;
+};
+
+// One open /proc/elevator_events, reading from event next on
+struct EventReader
+{
+    u64 next;
+};
+
+// Scheduling policy, returns the direction to leave the current floor in
+struct Policy
+{
+    const char *name;
+    int (*next_direction)(struct Elevator *elevator_thread);
+};
+
+// Boarding mode, picks who boards from the current floor
+struct Boarding
+{
+    const char *name;
+    void (*board)(struct Elevator *elevator_thread);
+};
+
+// Distribution of one trip metric, updated without locks
+struct Histogram
+{
+    atomic64_t count;
+    atomic64_t sum_us;
+    atomic64_t max_us;
+    atomic_t buckets[STATS_BUCKETS];
+};
+
+// Best choice of riders per type so far in board_packed()
+struct Packing
+{
+    int by_weight;
+    int available[NUM_TYPES];
+    int weights[NUM_TYPES];
+    int counts[NUM_TYPES];
+    int best[NUM_TYPES];
+    int best_riders;
+    int best_weight;
 };
 
 /*===========================================================================*/
@@ -75,62 +363,410 @@ struct Floors
 int start_elevator(void);
 int issue_request(int start_floor, int destination_floor, int type);
 int stop_elevator(void);
+int issue_requests(const void __user *requests, int __user *statuses, unsigned int count);
 
 // // Helper Functions
 void initialize_elevator(struct Elevator *elevator);
 void initialize_floors(struct Floors *floors);
-int activate_elevator(void *_elevator);
 
 // Passenger Functions
+static int valid_request(int start_floor, int destination_floor, int type);
+static struct Passenger *alloc_passenger(int type, int destination_floor, int starting_floor);
+static struct Elevator *enqueue_passenger(struct Passenger *passenger);
+static void free_passenger(struct Passenger *passenger);
+static struct mutex *floor_lock(int floor);
+static void drain_ingest(int floor);
+static void flush_ingest(int floor);
+static void unlock_floor(int floor);
+static void submit_passengers(struct llist_node *first);
 int create_passenger(int type, int destination_floor, int starting_floor);
 
+// Ring Functions
+static int consume_ring(struct Ring *ring);
+static void poll_rings(void);
+static bool cars_stepping(void);
+static bool rings_pending(void);
+static void put_ring_slot(void);
+static int ring_open(struct inode *inode, struct file *file);
+static int ring_release(struct inode *inode, struct file *file);
+static int ring_mmap(struct file *file, struct vm_area_struct *vma);
+static long ring_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+
+// Event Stream Functions
+static void record_event(int type, struct Elevator *car, int floor, int value, u64 id);
+static bool events_ready(struct EventReader *reader);
+static int take_events(struct EventReader *reader, struct elevator_event *events, int max);
+static int events_open(struct inode *inode, struct file *file);
+static int events_release(struct inode *inode, struct file *file);
+static ssize_t events_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos);
+static __poll_t events_poll(struct file *file, poll_table *wait);
+
+// Dispatcher Functions
+static u64 estimate_arrival(struct Elevator *car, int start_floor);
+static bool shares_stop(struct Elevator *car, int start_floor, int destination_floor);
+static struct Elevator *dispatch_passenger(struct Passenger *passenger);
+
+// Call Tracking Functions
+static void add_hall_call(struct Elevator *car, int floor);
+static void remove_hall_call(struct Elevator *car, int floor);
+static void add_car_call(struct Elevator *car, int floor);
+static void remove_car_call(struct Elevator *car, int floor);
+static int next_marked_floor(const unsigned long *map, int floor, int step);
+static struct list_head *hall_queue(struct Elevator *car, int floor, int type_index);
+static struct Passenger *next_boarder(struct Elevator *car, int floor);
+
 // Un/Loading Functions
 int can_load_passenger(struct Elevator *elevator_thread);
 void load_passenger(struct Elevator *elevator_thread);
 int can_unload_passenger(struct Elevator *elevator_thread);
 void unload_passenger(struct Elevator *elevator_thread);
 
+// Boarding Modes
+static void board_passenger(struct Elevator *elevator_thread, struct Passenger *passenger);
+static int times_skipped(struct Elevator *elevator_thread, struct Passenger *passenger);
+static void board_fifo(struct Elevator *elevator_thread);
+static void pack_search(struct Packing *packing, int type_index, int slots, int room, int riders, int weight);
+static void board_packed(struct Elevator *elevator_thread, int by_weight);
+static void board_riders(struct Elevator *elevator_thread);
+static void board_weight(struct Elevator *elevator_thread);
+static bool fits_on_board(struct Elevator *elevator_thread, struct Passenger *passenger);
+static struct Passenger *next_in_group(struct Elevator *elevator_thread, struct Passenger **candidates,
+                                       int num_candidates, int destination_floor, int *index);
+static void board_destination(struct Elevator *elevator_thread);
+
+// Trip Statistics
+static int stats_bucket(u64 us);
+static u64 bucket_limit(int bucket);
+static void histogram_add(struct Histogram *histogram, u64 us);
+static void histogram_reset(struct Histogram *histogram);
+static u64 trip_target_us(int type_index);
+static ktime_t trip_deadline(struct Passenger *passenger);
+static void record_trip(struct Passenger *passenger);
+static void reset_trip_stats(void);
+
+// Scheduling Policies
+static int floor_has_hall_call(struct Elevator *elevator_thread, int floor);
+static int closest_call_floor(struct Elevator *elevator_thread, int step, int hall_only);
+static int closest_call_direction(struct Elevator *elevator_thread, int hall_only);
+static int scan_direction(struct Elevator *elevator_thread);
+static int look_direction(struct Elevator *elevator_thread);
+static int nearest_direction(struct Elevator *elevator_thread);
+static int sstf_direction(struct Elevator *elevator_thread);
+static bool can_meet_deadline(struct Passenger *passenger, int distance, ktime_t now);
+static int last_call_floor(struct Elevator *elevator_thread, int step);
+static int sweep_distance(int floor, int target, int step, int turn_floor);
+static int edf_direction(struct Elevator *elevator_thread);
+
+// Parking Functions
+static void roll_parking_window(u64 window);
+static void record_arrival(int floor);
+static const u32 *parking_rates_now(int *bucket);
+static int choose_park_floor(struct Elevator *car);
+static void park_or_idle(struct Elevator *car);
+
+// Snapshot Functions
+static int publish_car(struct Elevator *car);
+static int publish_floor(int floor);
+static void publish_snapshots(struct Elevator *car);
+
 // Elevator Movement
+static void set_state(struct Elevator *elevator_thread, enum elevator_state state);
+static void step_floor(struct Elevator *elevator_thread, int direction);
+static void depart_floor(struct Elevator *elevator_thread);
 void move_elevator(struct Elevator *elevator_thread);
+static void schedule_step(struct Elevator *elevator_thread);
+static void kick_elevator(struct Elevator *elevator_thread);
+static enum hrtimer_restart elevator_timer(struct hrtimer *timer);
+static void elevator_work(struct work_struct *work);
 
 // Proc File Function
-static ssize_t elevator_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos);
+static int num_records(void);
+static void *elevator_seq_start(struct seq_file *m, loff_t *pos);
+static void *elevator_seq_next(struct seq_file *m, void *v, loff_t *pos);
+static void elevator_seq_stop(struct seq_file *m, void *v);
+static void show_car(struct seq_file *m, struct Elevator *car);
+static void show_floor(struct seq_file *m, int floor);
+static void show_totals(struct seq_file *m);
+static int elevator_seq_show(struct seq_file *m, void *v);
+static int num_stats_records(void);
+static void *stats_seq_start(struct seq_file *m, loff_t *pos);
+static void *stats_seq_next(struct seq_file *m, void *v, loff_t *pos);
+static void stats_seq_stop(struct seq_file *m, void *v);
+static void show_histogram(struct seq_file *m, const char *label, struct Histogram *histogram);
+static void show_slo(struct seq_file *m, int type_index);
+static int stats_seq_show(struct seq_file *m, void *v);
+static int stats_open(struct inode *inode, struct file *file);
+static ssize_t stats_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos);
+static void *parking_seq_start(struct seq_file *m, loff_t *pos);
+static void *parking_seq_next(struct seq_file *m, void *v, loff_t *pos);
+static void parking_seq_stop(struct seq_file *m, void *v);
+static void show_parking_car(struct seq_file *m, struct Elevator *car);
+static void show_parking_floor(struct seq_file *m, int floor);
+static int parking_seq_show(struct seq_file *m, void *v);
 
 // Cleanup Functions
-void clean_up(struct Elevator *elevator_thread, struct Floors *floors);
+void clean_up(struct Elevator *cars, int count, struct Floors *floors);
+static void stop_cars(void);
+static void free_building(void);
 
 // global variables
-struct Elevator elevator;
+struct Elevator *elevators;
 struct Floors floors;
 
+static int num_cars = 1;
+static int num_floors = 5;
+static int passenger_reserve = 0;
+static unsigned int ring_entries = 4096;
+static unsigned int event_entries = 4096;
+
+// A car takes travel_us to move one floor and stops dwell_us at a floor,
+// both divided by time_scale
+static unsigned int travel_us = 2000000;
+static unsigned int dwell_us = 1000000;
+static unsigned int time_scale = 1;
+
+// Passengers come from their own slab cache, backed by a mempool reserve
+// of passenger_reserve objects when that is set
+static struct kmem_cache *passenger_cache;
+static mempool_t *passenger_pool;
+static atomic64_t passenger_allocs = ATOMIC64_INIT(0);
+static atomic64_t passenger_alloc_ns = ATOMIC64_INIT(0);
+
+// Every car steps on this workqueue, from its own work item. Nothing is
+// rescheduled once elevators_unloading is set.
+static struct workqueue_struct *elevator_wq;
+static bool elevators_unloading;
+
+// Every open /dev/elevator, polled by the cars, and how many there are.
+// rings_mutex is taken before any ring_mutex, and neither is held with a
+// car's mutex.
+static LIST_HEAD(ring_list);
+static DEFINE_MUTEX(rings_mutex);
+static int num_rings;
+static atomic64_t ring_requests = ATOMIC64_INIT(0);
+static atomic64_t ring_doorbells = ATOMIC64_INIT(0);
+
+// The last event_entries events, for /proc/elevator_events. Each reader
+// follows at its own pace; one that falls a whole ring behind skips ahead
+// and is told how many it lost.
+static struct elevator_event *event_ring;
+static u64 events_written;
+static bool events_closing;
+static DEFINE_SPINLOCK(events_lock);
+static DECLARE_WAIT_QUEUE_HEAD(events_wait);
+static atomic64_t events_lost = ATOMIC64_INIT(0);
+
+// Wait, ride and trip time histograms by passenger type, and by starting
+// floor (num_floors * NUM_METRICS of them)
+static struct Histogram type_stats[NUM_TYPES][NUM_METRICS];
+static struct Histogram *floor_stats;
+
+// Target trip time (issue to drop-off) of each passenger type in ms,
+// before time_scale, and the trips of each type that took longer. The edf
+// policy serves riders by when their target runs out.
+static unsigned int trip_targets_ms[NUM_TYPES] = {120000, 120000, 120000, 120000};
+static atomic64_t slo_misses[NUM_TYPES];
+
+static const struct Policy policies[] = {
+    {"scan", scan_direction},
+    {"look", look_direction},
+    {"nearest", nearest_direction},
+    {"sstf", sstf_direction},
+    {"edf", edf_direction},
+};
+
+static const struct Policy *active_policy = &policies[0];
+
+static const struct Boarding boardings[] = {
+    {"fifo", board_fifo},
+    {"riders", board_riders},
+    {"weight", board_weight},
+    {"destination", board_destination},
+};
+
+static const struct Boarding *active_boarding = &boardings[0];
+
+// a rider left behind this many times boards before anyone else who fits
+static unsigned int boarding_age = 3;
+
+// In destination boarding, the longest grouping may delay a rider: by
+// being sent to a slower car that already stops at their floor, or by
+// being left behind at a full car (divided by time_scale, like travel_us)
+static unsigned int group_wait_us = 10000000;
+
+// Arrivals are counted per floor in parking_arrivals over the current
+// PARKING_WINDOW_S window, then folded into parking_rates, num_floors rates
+// for each hour of the day learned so far (parking_learned). parking_lock
+// serializes the folds; the rates are read without it. Rates are learned
+// whether or not parking sends idle cars anywhere.
+static bool parking = false;
+static DEFINE_SPINLOCK(parking_lock);
+static u64 parking_window;
+static unsigned long parking_learned;
+static atomic_t *parking_arrivals;
+static u32 *parking_rates;
+static atomic64_t parking_decisions = ATOMIC64_INIT(0);
+static atomic64_t parking_moves = ATOMIC64_INIT(0);
+static atomic64_t parking_floors = ATOMIC64_INIT(0);
+
 /*===========================================================================*/
-/*=============================Syscall Functions=============================*/
+/*=============================Module Parameters=============================*/
 /*===========================================================================*/
 
-int start_elevator(void)
+static int policy_set(const char *val, const struct kernel_param *kp)
 {
-    if (elevator.initialized)
+    for (int i = 0; i < ARRAY_SIZE(policies); ++i)
     {
-        if (elevator.deactivating)
+        if (sysfs_streq(val, policies[i].name))
         {
-            elevator.deactivating = 0;
+            // picked up by each car on its next departure
+            WRITE_ONCE(active_policy, &policies[i]);
+            return 0;
         }
-        return 1;
     }
-    else
+
+    return -EINVAL;
+}
+
+static int policy_get(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%s\n", READ_ONCE(active_policy)->name);
+}
+
+static const struct kernel_param_ops policy_ops = {
+    .set = policy_set,
+    .get = policy_get,
+};
+
+module_param_cb(policy, &policy_ops, NULL, 0644);
+MODULE_PARM_DESC(policy, "Scheduling policy: scan, look, nearest, sstf or edf (writable at runtime)");
+
+static int trip_targets_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned int targets[NUM_TYPES];
+
+    if (sscanf(val, "%u,%u,%u,%u", &targets[0], &targets[1], &targets[2], &targets[3]) != NUM_TYPES)
     {
-        mutex_init(&elevator.elevator_mutex);
-        initialize_elevator(&elevator);
-        elevator.thread = kthread_run(activate_elevator, &elevator, "thread elevator\n");
+        return -EINVAL;
     }
 
+    // picked up by riders already waiting as well as new ones
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        WRITE_ONCE(trip_targets_ms[i], targets[i]);
+    }
     return 0;
 }
 
+static int trip_targets_get(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%u,%u,%u,%u\n", READ_ONCE(trip_targets_ms[0]), READ_ONCE(trip_targets_ms[1]),
+                   READ_ONCE(trip_targets_ms[2]), READ_ONCE(trip_targets_ms[3]));
+}
+
+static const struct kernel_param_ops trip_targets_ops = {
+    .set = trip_targets_set,
+    .get = trip_targets_get,
+};
+
+module_param_cb(trip_targets, &trip_targets_ops, NULL, 0644);
+MODULE_PARM_DESC(trip_targets, "Target trip time in ms for types P,L,B,V (default 120000 each, writable at runtime)");
+
+static int boarding_set(const char *val, const struct kernel_param *kp)
+{
+    for (int i = 0; i < ARRAY_SIZE(boardings); ++i)
+    {
+        if (sysfs_streq(val, boardings[i].name))
+        {
+            // picked up at the next stop
+            WRITE_ONCE(active_boarding, &boardings[i]);
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
+static int boarding_get(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%s\n", READ_ONCE(active_boarding)->name);
+}
+
+static const struct kernel_param_ops boarding_ops = {
+    .set = boarding_set,
+    .get = boarding_get,
+};
+
+module_param_cb(boarding, &boarding_ops, NULL, 0644);
+MODULE_PARM_DESC(boarding, "Boarding mode: fifo, riders, weight or destination (writable at runtime)");
+
+module_param(boarding_age, uint, 0644);
+MODULE_PARM_DESC(boarding_age, "Times a rider can be left behind before boarding first (default 3)");
+
+module_param(group_wait_us, uint, 0644);
+MODULE_PARM_DESC(group_wait_us, "Longest destination boarding delays a rider to group stops (default 10000000)");
+
+module_param(parking, bool, 0644);
+MODULE_PARM_DESC(parking, "Send idle cars to where the next caller is expected (default 0, writable at runtime)");
+
+module_param(num_cars, int, 0444);
+MODULE_PARM_DESC(num_cars, "Number of elevator cars sharing the floors (default 1)");
+
+module_param(num_floors, int, 0444);
+MODULE_PARM_DESC(num_floors, "Number of floors in the building, 2 to 256 (default 5)");
+
+module_param(passenger_reserve, int, 0444);
+MODULE_PARM_DESC(passenger_reserve, "Passengers kept in reserve so requests cannot fail under memory pressure (default 0)");
+
+module_param(ring_entries, uint, 0444);
+MODULE_PARM_DESC(ring_entries, "Requests each /dev/elevator ring holds, a power of two (default 4096)");
+
+module_param(event_entries, uint, 0444);
+MODULE_PARM_DESC(event_entries, "Events /proc/elevator_events keeps for slow readers, a power of two (default 4096)");
+
+module_param(travel_us, uint, 0644);
+MODULE_PARM_DESC(travel_us, "Microseconds to move one floor (default 2000000)");
+
+module_param(dwell_us, uint, 0644);
+MODULE_PARM_DESC(dwell_us, "Microseconds stopped at a floor to load and unload (default 1000000)");
+
+module_param(time_scale, uint, 0644);
+MODULE_PARM_DESC(time_scale, "Divides travel_us and dwell_us, e.g. 1000 runs the elevator 1000x faster (default 1)");
+
+/*===========================================================================*/
+/*=============================Syscall Functions=============================*/
+/*===========================================================================*/
+
+int start_elevator(void)
+{
+    struct Elevator *car;
+    int running = 0;
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        car = &elevators[i];
+        if (car->initialized)
+        {
+            if (car->deactivating)
+            {
+                car->deactivating = 0;
+            }
+            running = 1;
+        }
+        else
+        {
+            initialize_elevator(car);
+            queue_work(elevator_wq, &car->work);
+        }
+    }
+
+    return running;
+}
+
 int issue_request(int start_floor, int destination_floor, int type)
 {
     // Validate input
-    if (start_floor < 1 || start_floor > 5 || destination_floor < 1 || destination_floor > 5 || type < 0 || type > 3)
+    if (!valid_request(start_floor, destination_floor, type))
     {
         return 1;
     }
@@ -138,21 +774,118 @@ int issue_request(int start_floor, int destination_floor, int type)
     return create_passenger(type, destination_floor, start_floor);
 }
 
-int stop_elevator(void)
+// Vectored issue_request(): every valid entry is allocated up front and the
+// whole batch is queued once it has all been copied in. statuses[i]
+// gets what issue_request() would have returned for requests[i]. Returns the
+// number of passengers queued, or a negative errno if nothing was.
+int issue_requests(const void __user *requests, int __user *statuses, unsigned int count)
 {
-    mutex_lock_interruptible(&elevator.elevator_mutex);
-    if (elevator.deactivating)
+    const struct elevator_request __user *user_requests = requests;
+    struct elevator_request *chunk;
+    struct Passenger *passenger, *next;
+    struct llist_node *first = NULL;
+    unsigned int done, todo;
+    int *chunk_statuses;
+    int accepted = 0;
+    int ret;
+    LIST_HEAD(batch);
+
+    if (count > ISSUE_BATCH_MAX)
     {
-        mutex_unlock(&elevator.elevator_mutex);
-        return 1;
+        return -EINVAL;
     }
-    else
+
+    chunk = kmalloc_array(ISSUE_CHUNK, sizeof(struct elevator_request), GFP_KERNEL);
+    chunk_statuses = kmalloc_array(ISSUE_CHUNK, sizeof(int), GFP_KERNEL);
+    if (!chunk || !chunk_statuses)
     {
-        elevator.deactivating = 1;
+        ret = -ENOMEM;
+        goto out;
     }
 
-    mutex_unlock(&elevator.elevator_mutex);
-    return 0;
+    for (done = 0; done < count; done += todo)
+    {
+        todo = min(count - done, (unsigned int)ISSUE_CHUNK);
+        if (copy_from_user(chunk, user_requests + done, todo * sizeof(struct elevator_request)))
+        {
+            ret = -EFAULT;
+            goto out;
+        }
+
+        for (unsigned int i = 0; i < todo; ++i)
+        {
+            chunk_statuses[i] = 1;
+            if (!valid_request(chunk[i].start_floor, chunk[i].destination_floor, chunk[i].type))
+            {
+                continue;
+            }
+
+            passenger = alloc_passenger(chunk[i].type, chunk[i].destination_floor, chunk[i].start_floor);
+            if (!passenger)
+            {
+                continue;
+            }
+
+            list_add_tail(&passenger->list, &batch);
+            chunk_statuses[i] = 0;
+            accepted++;
+        }
+
+        if (copy_to_user(statuses + done, chunk_statuses, todo * sizeof(int)))
+        {
+            ret = -EFAULT;
+            goto out;
+        }
+    }
+
+    // chained newest first, as submit_passengers() takes them
+    list_for_each_entry_safe(passenger, next, &batch, list)
+    {
+        list_del(&passenger->list);
+        passenger->ingest.next = first;
+        first = &passenger->ingest;
+    }
+    if (first)
+    {
+        submit_passengers(first);
+    }
+    ret = accepted;
+
+out:
+    // anyone still on the batch list was never queued
+    list_for_each_entry_safe(passenger, next, &batch, list)
+    {
+        list_del(&passenger->list);
+        free_passenger(passenger);
+    }
+    kfree(chunk);
+    kfree(chunk_statuses);
+
+    return ret;
+}
+
+int stop_elevator(void)
+{
+    struct Elevator *car;
+    int stopping = 0;
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        car = &elevators[i];
+        mutex_lock(&car->elevator_mutex);
+        if (car->deactivating)
+        {
+            stopping = 1;
+        }
+        else
+        {
+            car->deactivating = 1;
+        }
+        mutex_unlock(&car->elevator_mutex);
+        kick_elevator(car);
+    }
+
+    return stopping;
 }
 
 /*===========================================================================*/
@@ -161,12 +894,11 @@ int stop_elevator(void)
 
 void initialize_elevator(struct Elevator *elevator)
 {
-    mutex_lock_interruptible(&elevator->elevator_mutex);
-    elevator->current_state = 1;
+    mutex_lock(&elevator->elevator_mutex);
+    set_state(elevator, IDLE);
     elevator->weight = 0;
     elevator->num_passengers = 0;
     INIT_LIST_HEAD(&elevator->elevator_list);
-    elevator->thread = NULL;
     elevator->initialized = 1;
     elevator->deactivating = 0;
     mutex_unlock(&elevator->elevator_mutex);
@@ -174,40 +906,54 @@ void initialize_elevator(struct Elevator *elevator)
 
 void initialize_floors(struct Floors *floors)
 {
-    mutex_lock_interruptible(&floors->floors_mutex);
-    for (int i = 0; i < 5; ++i)
+    for (int i = 0; i < num_floors; ++i)
     {
+        mutex_lock(&floors->floor_locks[i]);
         INIT_LIST_HEAD(&floors->floor_lists[i]);
         floors->curr_waiting[i] = 0;
+        floors->next_seq[i] = 0;
+        mutex_unlock(&floors->floor_locks[i]);
     }
     floors->initialized = 1;
-    floors->num_passengers_waiting = 0;
-    mutex_unlock(&floors->floors_mutex);
-}
-
-int activate_elevator(void *_elevator)
-{
-    struct Elevator *elevator_thread = (struct Elevator *)_elevator;
-    while (!kthread_should_stop())
-    {
-        move_elevator(elevator_thread);
-    }
-    return 0;
+    atomic_set(&floors->num_passengers_waiting, 0);
 }
 
 /*===========================================================================*/
 /*============================Passenger Functions============================*/
 /*===========================================================================*/
 
-int create_passenger(int type, int destination_floor, int starting_floor)
+static int valid_request(int start_floor, int destination_floor, int type)
 {
-    struct Passenger *passenger = kmalloc(sizeof(struct Passenger), GFP_KERNEL);
+    return start_floor >= 1 && start_floor <= num_floors &&
+           destination_floor >= 1 && destination_floor <= num_floors &&
+           type >= 0 && type <= 3;
+}
+
+// Allocates a passenger that is not on any floor yet
+static struct Passenger *alloc_passenger(int type, int destination_floor, int starting_floor)
+{
+    u64 start = local_clock();
+    struct Passenger *passenger;
+
+    if (passenger_pool)
+    {
+        // only sleeps, never fails, once the reserve is in use
+        passenger = mempool_alloc(passenger_pool, GFP_KERNEL);
+    }
+    else
+    {
+        passenger = kmem_cache_alloc(passenger_cache, GFP_KERNEL);
+    }
     if (!passenger)
     {
-        // Handle allocation failure
-        return 1;
+        return NULL;
     }
 
+    atomic64_add(local_clock() - start, &passenger_alloc_ns);
+    passenger->id = atomic64_inc_return(&passenger_allocs);
+    passenger->issued = ktime_get();
+
+    passenger->type_index = type;
     switch (type)
     {
     case 0:
@@ -231,443 +977,2715 @@ int create_passenger(int type, int destination_floor, int starting_floor)
     passenger->destination_floor = destination_floor;
     passenger->starting_floor = starting_floor;
 
-    mutex_lock_interruptible(&floors.floors_mutex);
-    list_add_tail(&passenger->list, &floors.floor_lists[passenger->starting_floor - 1]);
-    floors.curr_waiting[passenger->starting_floor - 1]++;
-    floors.num_passengers_waiting++;
-    mutex_unlock(&floors.floors_mutex);
-
-    return 0;
+    return passenger;
 }
 
-/*===========================================================================*/
-/*===========================Un/Loading Functions============================*/
-/*===========================================================================*/
-
-int can_load_passenger(struct Elevator *elevator_thread)
+static void free_passenger(struct Passenger *passenger)
 {
-    struct Passenger *temp_node;
-
-    if (floors.curr_waiting[elevator_thread->current_floor - 1] != 0)
+    if (passenger_pool)
     {
-        list_for_each_entry(temp_node, &floors.floor_lists[elevator_thread->current_floor - 1], list)
-        {
-            if (elevator_thread->num_passengers < 5 &&
-                elevator_thread->weight + temp_node->weight <= 700)
-            {
-                return 1;
-            }
-        }
+        mempool_free(passenger, passenger_pool);
+    }
+    else
+    {
+        kmem_cache_free(passenger_cache, passenger);
     }
+}
 
-    return 0;
+// Dispatches the passenger to a car and queues it on its starting floor.
+// Caller holds that floor's lock and kicks the returned car afterwards.
+static struct Elevator *enqueue_passenger(struct Passenger *passenger)
+{
+    int floor = passenger->starting_floor;
+    struct Elevator *car;
+
+    lockdep_assert_held(floor_lock(floor));
+    car = dispatch_passenger(passenger);
+
+    passenger->car = car->id;
+    passenger->seq = floors.next_seq[floor - 1]++;
+    passenger->stops_seen = car->hall_stops[floor - 1];
+    // the car peeks at the heads of its queues on other floors unlocked
+    list_add_tail_rcu(&passenger->queue, hall_queue(car, floor, passenger->type_index));
+    add_hall_call(car, floor);
+
+    list_add_tail(&passenger->list, &floors.floor_lists[floor - 1]);
+    floors.curr_waiting[floor - 1]++;
+    atomic_inc(&floors.num_passengers_waiting);
+    set_bit(floor - 1, floors.stale_map);
+    record_arrival(floor);
+
+    trace_passenger_enqueue(car->id, passenger->type, floor, passenger->destination_floor,
+                            floors.curr_waiting[floor - 1],
+                            atomic_read(&floors.num_passengers_waiting));
+    record_event(ELEVATOR_EVENT_ENQUEUE, car, passenger->starting_floor,
+                 passenger->destination_floor, passenger->id);
+
+    return car;
 }
 
-void load_passenger(struct Elevator *elevator_thread)
+static struct mutex *floor_lock(int floor)
 {
-    struct Passenger *first, *second;
+    return &floors.floor_locks[floor - 1];
+}
 
-    list_for_each_entry_safe(first, second, &floors.floor_lists[elevator_thread->current_floor - 1], list)
-    {
-        if (elevator_thread->num_passengers < 5 && elevator_thread->weight + first->weight <= 700)
-        {
-            // remove the passenger from the floors list
-            list_del(&first->list);
+// Queues everyone pushed onto the floor's ingest list, in arrival order.
+// Caller holds the floor's lock.
+static void drain_ingest(int floor)
+{
+    struct llist_node *pending = llist_del_all(&floors.ingest[floor - 1]);
+    struct Passenger *passenger;
+    struct Elevator *car;
 
-            // add the passenger to elevator list
-            list_add_tail(&first->list, &elevator_thread->elevator_list);
+    lockdep_assert_held(floor_lock(floor));
+    pending = llist_reverse_order(pending);
+    while (pending)
+    {
+        passenger = llist_entry(pending, struct Passenger, ingest);
+        pending = pending->next;
 
-            elevator_thread->weight += first->weight;
-            elevator_thread->num_passengers++;
-            floors.num_passengers_waiting--;
-            floors.curr_waiting[elevator_thread->current_floor - 1]--;
+        car = enqueue_passenger(passenger);
+        // a car that is offline takes no steps to publish the floor
+        if (READ_ONCE(car->current_state) == OFFLINE)
+        {
+            publish_floor(floor);
         }
+        // an idle car reacts at once instead of on its next poll
+        kick_elevator(car);
     }
 }
 
-int can_unload_passenger(struct Elevator *elevator_thread)
+// Drains the floor's ingest list if its lock is free. If it is not, the
+// holder drains the list in unlock_floor(): the barrier here pairs with
+// the one there, so either we see the lock released or the holder sees
+// what was pushed.
+static void flush_ingest(int floor)
 {
-    struct Passenger *temp_node;
+    struct mutex *lock = floor_lock(floor);
 
-    list_for_each_entry(temp_node, &elevator_thread->elevator_list, list)
+    smp_mb();
+    while (!llist_empty(&floors.ingest[floor - 1]) && mutex_trylock(lock))
     {
-        if (temp_node->destination_floor == elevator_thread->current_floor)
-        {
-            return 1;
-        }
+        drain_ingest(floor);
+        mutex_unlock(lock);
+        smp_mb();
     }
+}
 
-    return 0;
+// Every floor lock taken while passengers may be submitted is released
+// through here, so nobody pushed while it was held is left behind
+static void unlock_floor(int floor)
+{
+    mutex_unlock(floor_lock(floor));
+    flush_ingest(floor);
 }
 
-void unload_passenger(struct Elevator *elevator_thread)
+// Queues a chain of passengers, linked newest first, in arrival order. Each
+// one is pushed onto its starting floor's ingest list, which is then
+// drained once per run of riders from the same floor, without waiting for
+// the floor's lock.
+static void submit_passengers(struct llist_node *first)
 {
-    struct Passenger *first, *second;
-    int temp_weight;
+    struct llist_node *pending = llist_reverse_order(first);
+    struct Passenger *passenger;
+    int floor;
 
-    // iterate over each passenger currently on the elevator
-    list_for_each_entry_safe(first, second, &elevator_thread->elevator_list, list)
+    while (pending)
     {
-        if (first->destination_floor == elevator_thread->current_floor)
-        {
-            temp_weight = first->weight;
-            list_del(&first->list);
-            kfree(first);
+        passenger = llist_entry(pending, struct Passenger, ingest);
+        pending = pending->next;
+        floor = passenger->starting_floor;
 
-            elevator_thread->num_serviced++;
-            elevator_thread->num_passengers--;
-            elevator_thread->weight -= temp_weight;
+        llist_add(&passenger->ingest, &floors.ingest[floor - 1]);
+        if (!pending || llist_entry(pending, struct Passenger, ingest)->starting_floor != floor)
+        {
+            flush_ingest(floor);
         }
     }
 }
 
+int create_passenger(int type, int destination_floor, int starting_floor)
+{
+    struct Passenger *passenger = alloc_passenger(type, destination_floor, starting_floor);
+    if (!passenger)
+    {
+        // Handle allocation failure
+        return 1;
+    }
+
+    passenger->ingest.next = NULL;
+    submit_passengers(&passenger->ingest);
+
+    return 0;
+}
+
 /*===========================================================================*/
-/*=============================Elevator Movement=============================*/
+/*==============================Ring Functions===============================*/
 /*===========================================================================*/
 
-void move_elevator(struct Elevator *elevator_thread)
+// Takes the requests published on the ring, as many as the completion ring
+// has room for, and submits the passengers as one chain before posting
+// their completions. Caller holds ring_mutex. Returns the number taken.
+static int consume_ring(struct Ring *ring)
 {
-    switch (elevator_thread->current_state)
-    {
+    struct elevator_ring_header *header = ring->header;
+    u32 entries = ring_entries;
+    u32 tail = smp_load_acquire(&header->sq_tail);
+    u32 room = entries - (ring->cq_tail - READ_ONCE(header->cq_head));
+    u32 count = min3(tail - ring->sq_head, room, entries);
+    struct llist_node *first = NULL;
+    struct Passenger *passenger;
+    struct elevator_sqe sqe;
+    struct elevator_cqe *cqe;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        // copied once, userspace may still be writing to a stale slot
+        memcpy(&sqe, &ring->sq[(ring->sq_head + i) & (entries - 1)], sizeof(sqe));
+        cqe = &ring->cq[(ring->cq_tail + i) & (entries - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->status = 1;
+        cqe->passenger_id = 0;
+
+        if (!valid_request(sqe.start_floor, sqe.destination_floor, sqe.type))
+        {
+            continue;
+        }
+        passenger = alloc_passenger(sqe.type, sqe.destination_floor, sqe.start_floor);
+        if (!passenger)
+        {
+            continue;
+        }
+
+        // chained newest first, as submit_passengers() takes them
+        passenger->ingest.next = first;
+        first = &passenger->ingest;
+        cqe->status = 0;
+        cqe->passenger_id = passenger->id;
+    }
+
+    ring->sq_head += count;
+    smp_store_release(&header->sq_head, ring->sq_head);
+    if (first)
+    {
+        submit_passengers(first);
+    }
+    ring->cq_tail += count;
+    smp_store_release(&header->cq_tail, ring->cq_tail);
+    atomic64_add(count, &ring_requests);
+
+    return count;
+}
+
+// Consumes whatever is waiting on every ring. Each car does this at the start
+// of every step, so while any car is busy no request needs a syscall.
+static void poll_rings(void)
+{
+    struct Ring *ring;
+
+    mutex_lock(&rings_mutex);
+    list_for_each_entry(ring, &ring_list, list)
+    {
+        WRITE_ONCE(ring->header->flags, 0);
+        smp_mb();
+        // a doorbell already consuming this ring takes these too
+        if (mutex_trylock(&ring->ring_mutex))
+        {
+            consume_ring(ring);
+            mutex_unlock(&ring->ring_mutex);
+        }
+    }
+    mutex_unlock(&rings_mutex);
+}
+
+// Whether any car is moving or loading, and so polls the rings at its next
+// step
+static bool cars_stepping(void)
+{
+    enum elevator_state state;
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        state = READ_ONCE(elevators[i].current_state);
+        if (state != IDLE && state != OFFLINE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Called as a car goes idle. Once no car is stepping, asks for the doorbell
+// on every ring, then returns whether a request that can be taken was
+// published before userspace could see that. Checked under rings_mutex, so
+// of two cars going idle together the second sees the first.
+static bool rings_pending(void)
+{
+    struct elevator_ring_header *header;
+    struct Ring *ring;
+    bool pending = false;
+
+    mutex_lock(&rings_mutex);
+    if (cars_stepping())
+    {
+        mutex_unlock(&rings_mutex);
+        return false;
+    }
+    list_for_each_entry(ring, &ring_list, list)
+    {
+        header = ring->header;
+        WRITE_ONCE(header->flags, ELEVATOR_RING_NEED_WAKEUP);
+        smp_mb();
+        if (READ_ONCE(header->sq_tail) != ring->sq_head &&
+            ring->cq_tail - READ_ONCE(header->cq_head) < ring_entries)
+        {
+            pending = true;
+        }
+    }
+    mutex_unlock(&rings_mutex);
+
+    return pending;
+}
+
+static void put_ring_slot(void)
+{
+    mutex_lock(&rings_mutex);
+    num_rings--;
+    mutex_unlock(&rings_mutex);
+}
+
+// Every car step walks every ring, so their number is capped, and a slot is
+// taken before anything is allocated
+static int ring_open(struct inode *inode, struct file *file)
+{
+    size_t sq_offset = ALIGN(sizeof(struct elevator_ring_header), SMP_CACHE_BYTES);
+    size_t cq_offset = sq_offset + ring_entries * sizeof(struct elevator_sqe);
+    struct Ring *ring;
+
+    mutex_lock(&rings_mutex);
+    if (num_rings == RINGS_MAX)
+    {
+        mutex_unlock(&rings_mutex);
+        return -EMFILE;
+    }
+    num_rings++;
+    mutex_unlock(&rings_mutex);
+
+    ring = kzalloc(sizeof(struct Ring), GFP_KERNEL);
+    if (!ring)
+    {
+        put_ring_slot();
+        return -ENOMEM;
+    }
+
+    ring->size = cq_offset + ring_entries * sizeof(struct elevator_cqe);
+    ring->header = vmalloc_user(ring->size);
+    if (!ring->header)
+    {
+        kfree(ring);
+        put_ring_slot();
+        return -ENOMEM;
+    }
+    ring->sq = (void *)ring->header + sq_offset;
+    ring->cq = (void *)ring->header + cq_offset;
+    ring->header->entries = ring_entries;
+    ring->header->sq_offset = sq_offset;
+    ring->header->cq_offset = cq_offset;
+    ring->header->flags = ELEVATOR_RING_NEED_WAKEUP;
+    mutex_init(&ring->ring_mutex);
+
+    mutex_lock(&rings_mutex);
+    list_add_tail(&ring->list, &ring_list);
+    mutex_unlock(&rings_mutex);
+
+    file->private_data = ring;
+    return 0;
+}
+
+// Requests still on the ring are dropped with it
+static int ring_release(struct inode *inode, struct file *file)
+{
+    struct Ring *ring = file->private_data;
+
+    mutex_lock(&rings_mutex);
+    list_del(&ring->list);
+    num_rings--;
+    mutex_unlock(&rings_mutex);
+
+    mutex_destroy(&ring->ring_mutex);
+    vfree(ring->header);
+    kfree(ring);
+    return 0;
+}
+
+// The whole ring is mapped at once, from offset 0
+static int ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct Ring *ring = file->private_data;
+
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_ALIGN(ring->size))
+    {
+        return -EINVAL;
+    }
+
+    return remap_vmalloc_range(vma, ring->header, 0);
+}
+
+// ELEVATOR_IOC_DOORBELL consumes the ring now, for when every car is idle.
+// Returns the number of requests taken.
+static long ring_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct Ring *ring = file->private_data;
+    int taken;
+
+    if (cmd != ELEVATOR_IOC_DOORBELL)
+    {
+        return -ENOTTY;
+    }
+
+    atomic64_inc(&ring_doorbells);
+    mutex_lock(&ring->ring_mutex);
+    taken = consume_ring(ring);
+    mutex_unlock(&ring->ring_mutex);
+
+    return taken;
+}
+
+/*===========================================================================*/
+/*===========================Event Stream Functions==========================*/
+/*===========================================================================*/
+
+// Appends an event to the ring and wakes anyone reading the stream. The
+// car's counts are read without its mutex, callers other than the car's own
+// step only hold a floor lock.
+static void record_event(int type, struct Elevator *car, int floor, int value, u64 id)
+{
+    struct elevator_event *event;
+
+    spin_lock(&events_lock);
+    event = &event_ring[events_written & (event_entries - 1)];
+    event->timestamp_ns = ktime_get_ns();
+    event->id = id;
+    event->seq = events_written;
+    event->type = type;
+    event->car = car->id;
+    event->floor = floor;
+    event->value = value;
+    event->passengers = READ_ONCE(car->num_passengers);
+    event->waiting = min_t(int, atomic_read(&floors.num_passengers_waiting), U16_MAX);
+    WRITE_ONCE(events_written, events_written + 1);
+    spin_unlock(&events_lock);
+
+    // wq_has_sleeper() orders the new count before the check
+    if (wq_has_sleeper(&events_wait))
+    {
+        wake_up_interruptible(&events_wait);
+    }
+}
+
+// also true once the module is unloading, so a blocked read returns
+static bool events_ready(struct EventReader *reader)
+{
+    return READ_ONCE(events_written) != reader->next || READ_ONCE(events_closing);
+}
+
+// Copies up to max events the reader has not seen into events, preceded by
+// an ELEVATOR_EVENT_OVERRUN record if the ring has wrapped past it. Returns
+// the number of records.
+static int take_events(struct EventReader *reader, struct elevator_event *events, int max)
+{
+    int count = 0;
+    u64 lost;
+
+    spin_lock(&events_lock);
+    if (events_written - reader->next > event_entries)
+    {
+        lost = events_written - event_entries - reader->next;
+        memset(&events[0], 0, sizeof(struct elevator_event));
+        events[0].timestamp_ns = ktime_get_ns();
+        events[0].id = lost;
+        events[0].seq = reader->next;
+        events[0].type = ELEVATOR_EVENT_OVERRUN;
+        reader->next += lost;
+        atomic64_add(lost, &events_lost);
+        count++;
+    }
+
+    for (; count < max && reader->next != events_written; ++count)
+    {
+        events[count] = event_ring[reader->next++ & (event_entries - 1)];
+    }
+    spin_unlock(&events_lock);
+
+    return count;
+}
+
+// A new reader starts with the next event, not the backlog
+static int events_open(struct inode *inode, struct file *file)
+{
+    struct EventReader *reader = kzalloc(sizeof(struct EventReader), GFP_KERNEL);
+
+    if (!reader)
+    {
+        return -ENOMEM;
+    }
+
+    spin_lock(&events_lock);
+    reader->next = events_written;
+    spin_unlock(&events_lock);
+
+    file->private_data = reader;
+    return stream_open(inode, file);
+}
+
+static int events_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    return 0;
+}
+
+// Reads whole records only, blocking until there is at least one unless the
+// file is non-blocking
+static ssize_t events_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+{
+    struct EventReader *reader = file->private_data;
+    struct elevator_event events[EVENT_CHUNK];
+    size_t max = count / sizeof(struct elevator_event);
+    size_t done = 0;
+    int taken;
+    int ret;
+
+    if (max == 0)
+    {
+        return -EINVAL;
+    }
+
+    if (!events_ready(reader))
+    {
+        if (file->f_flags & O_NONBLOCK)
+        {
+            return -EAGAIN;
+        }
+        ret = wait_event_interruptible(events_wait, events_ready(reader));
+        if (ret)
+        {
+            return ret;
+        }
+    }
+
+    while (done < max)
+    {
+        taken = take_events(reader, events, min_t(size_t, max - done, EVENT_CHUNK));
+        if (taken == 0)
+        {
+            break;
+        }
+        if (copy_to_user(ubuf + done * sizeof(struct elevator_event), events,
+                         taken * sizeof(struct elevator_event)))
+        {
+            return done ? done * sizeof(struct elevator_event) : -EFAULT;
+        }
+        done += taken;
+    }
+
+    return done * sizeof(struct elevator_event);
+}
+
+static __poll_t events_poll(struct file *file, poll_table *wait)
+{
+    struct EventReader *reader = file->private_data;
+
+    poll_wait(file, &events_wait, wait);
+    return events_ready(reader) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+/*===========================================================================*/
+/*===========================Dispatcher Functions============================*/
+/*===========================================================================*/
+
+// Estimated microseconds until the car can pick someone up at start_floor:
+// it finishes its current sweep before turning around, travels travel_us
+// per floor and dwells dwell_us for every rider it already owes a stop to.
+// Car state is read without its mutex, a stale estimate only costs accuracy.
+static u64 estimate_arrival(struct Elevator *car, int start_floor)
+{
+    int current_floor = READ_ONCE(car->current_floor);
+    int direction = READ_ONCE(car->direction);
+    enum elevator_state state = READ_ONCE(car->current_state);
+    int turn_floor = direction ? num_floors : 1;
+    int distance;
+
+    if (state == OFFLINE || state == IDLE || start_floor == current_floor ||
+        (direction && start_floor > current_floor) || (!direction && start_floor < current_floor))
+    {
+        distance = abs(start_floor - current_floor);
+    }
+    else
+    {
+        distance = abs(turn_floor - current_floor) + abs(turn_floor - start_floor);
+    }
+
+    return (u64)distance * READ_ONCE(travel_us) +
+           (u64)(atomic_read(&car->num_assigned) + READ_ONCE(car->num_passengers)) * READ_ONCE(dwell_us);
+}
+
+// Whether the car already has to stop at destination_floor, for a rider on
+// board or one of the first it has waiting on start_floor. Caller holds
+// start_floor's lock; the riders on board are only peeked at.
+static bool shares_stop(struct Elevator *car, int start_floor, int destination_floor)
+{
+    struct Passenger *passenger;
+    int scanned;
+
+    if (test_bit(destination_floor - 1, car->car_map))
+    {
+        return true;
+    }
+
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        scanned = 0;
+        list_for_each_entry(passenger, hall_queue(car, start_floor, i), queue)
+        {
+            if (passenger->destination_floor == destination_floor)
+            {
+                return true;
+            }
+            if (++scanned == GROUP_SCAN)
+            {
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Assigns the passenger to the car with the lowest estimated time to
+// arrival. In destination boarding a car that stops at the passenger's
+// destination anyway is preferred, if it is at most group_wait_us slower,
+// so riders bound for the same floor share a car and a stop. Caller holds
+// the starting floor's lock, no car's.
+static struct Elevator *dispatch_passenger(struct Passenger *passenger)
+{
+    bool grouping = READ_ONCE(active_boarding)->board == board_destination;
+    struct Elevator *best = NULL, *group = NULL;
+    u64 best_eta = U64_MAX, group_eta = U64_MAX;
+    u64 eta;
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        eta = estimate_arrival(&elevators[i], passenger->starting_floor);
+        if (eta < best_eta)
+        {
+            best = &elevators[i];
+            best_eta = eta;
+        }
+        if (grouping && eta < group_eta &&
+            shares_stop(&elevators[i], passenger->starting_floor, passenger->destination_floor))
+        {
+            group = &elevators[i];
+            group_eta = eta;
+        }
+    }
+
+    return group && group_eta - best_eta <= READ_ONCE(group_wait_us) ? group : best;
+}
+
+/*===========================================================================*/
+/*==========================Call Tracking Functions==========================*/
+/*===========================================================================*/
+
+// Every car counts its hall calls (riders assigned to it, per starting
+// floor, under that floor's lock) and car calls (riders on board, per
+// destination, under elevator_mutex). A bit is set in hall_map/car_map for
+// each floor with a nonzero count, so the policies find the next call with
+// a bitmap search instead of visiting every floor. The riders behind the
+// hall calls are also queued per floor and type in hall_queues, in arrival
+// order, so whether anyone fits is a check of at most NUM_TYPES heads.
+//
+// Floors other than the one a car is stopped at are only peeked at, without
+// their locks: hall_map is updated with atomic bit operations, riders are
+// only added to a hall queue at its tail, and only the car itself removes
+// them. A stale peek only sends the car the wrong way for a floor.
+
+static void add_hall_call(struct Elevator *car, int floor)
+{
+    if (car->hall_calls[floor - 1]++ == 0)
+    {
+        set_bit(floor - 1, car->hall_map);
+    }
+    atomic_inc(&car->num_assigned);
+}
+
+static void remove_hall_call(struct Elevator *car, int floor)
+{
+    if (--car->hall_calls[floor - 1] == 0)
+    {
+        clear_bit(floor - 1, car->hall_map);
+    }
+    atomic_dec(&car->num_assigned);
+}
+
+static void add_car_call(struct Elevator *car, int floor)
+{
+    if (car->car_calls[floor - 1]++ == 0)
+    {
+        __set_bit(floor - 1, car->car_map);
+    }
+}
+
+static void remove_car_call(struct Elevator *car, int floor)
+{
+    if (--car->car_calls[floor - 1] == 0)
+    {
+        __clear_bit(floor - 1, car->car_map);
+    }
+}
+
+// Closest floor past the given one, in direction step, with its bit set in
+// map. Returns 0 when there is none.
+static int next_marked_floor(const unsigned long *map, int floor, int step)
+{
+    unsigned long bit;
+
+    if (step > 0)
+    {
+        // floor n is bit n - 1, so the floors above start at bit floor
+        bit = find_next_bit(map, num_floors, floor);
+        return bit < num_floors ? bit + 1 : 0;
+    }
+
+    bit = find_last_bit(map, floor - 1);
+    return bit < floor - 1 ? bit + 1 : 0;
+}
+
+// Riders assigned to the car waiting on the floor with the given type
+static struct list_head *hall_queue(struct Elevator *car, int floor, int type_index)
+{
+    return &car->hall_queues[(floor - 1) * NUM_TYPES + type_index];
+}
+
+// Earliest arrival assigned to the car on the floor who fits on board, or
+// NULL if nobody does. The head of each type queue is the only one of its
+// weight worth checking.
+static struct Passenger *next_boarder(struct Elevator *car, int floor)
+{
+    struct Passenger *best = NULL;
+    struct Passenger *head;
+
+    if (car->num_passengers >= 5 || READ_ONCE(car->hall_calls[floor - 1]) == 0)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        head = list_first_entry_or_null(hall_queue(car, floor, i), struct Passenger, queue);
+        if (head && car->weight + head->weight <= 700 && (!best || head->seq < best->seq))
+        {
+            best = head;
+        }
+    }
+
+    return best;
+}
+
+/*===========================================================================*/
+/*===========================Un/Loading Functions============================*/
+/*===========================================================================*/
+
+int can_load_passenger(struct Elevator *elevator_thread)
+{
+    return next_boarder(elevator_thread, elevator_thread->current_floor) != NULL;
+}
+
+// Boards riders as the active boarding mode picks them. Everyone assigned
+// to this car who is still waiting afterwards has been left behind once more.
+void load_passenger(struct Elevator *elevator_thread)
+{
+    READ_ONCE(active_boarding)->board(elevator_thread);
+    elevator_thread->hall_stops[elevator_thread->current_floor - 1]++;
+}
+
+int can_unload_passenger(struct Elevator *elevator_thread)
+{
+    return elevator_thread->car_calls[elevator_thread->current_floor - 1] != 0;
+}
+
+void unload_passenger(struct Elevator *elevator_thread)
+{
+    struct Passenger *first, *second;
+    int temp_weight;
+
+    // iterate over each passenger currently on the elevator, until nobody
+    // left is headed here
+    list_for_each_entry_safe(first, second, &elevator_thread->elevator_list, list)
+    {
+        if (!can_unload_passenger(elevator_thread))
+        {
+            break;
+        }
+
+        if (first->destination_floor == elevator_thread->current_floor)
+        {
+            temp_weight = first->weight;
+            remove_car_call(elevator_thread, first->destination_floor);
+            list_del(&first->list);
+            record_trip(first);
+
+            elevator_thread->num_serviced++;
+            elevator_thread->num_passengers--;
+            elevator_thread->weight -= temp_weight;
+
+            trace_passenger_alight(elevator_thread->id, first->type, elevator_thread->current_floor,
+                                   elevator_thread->weight, elevator_thread->num_passengers,
+                                   ktime_us_delta(ktime_get(), first->issued));
+            record_event(ELEVATOR_EVENT_ALIGHT, elevator_thread, elevator_thread->current_floor,
+                         first->destination_floor, first->id);
+            free_passenger(first);
+        }
+    }
+}
+
+/*===========================================================================*/
+/*==============================Boarding Modes===============================*/
+/*===========================================================================*/
+
+static void board_passenger(struct Elevator *elevator_thread, struct Passenger *passenger)
+{
+    lockdep_assert_held(&elevator_thread->elevator_mutex);
+    lockdep_assert_held(floor_lock(elevator_thread->current_floor));
+
+    // remove the passenger from the floors list
+    list_del(&passenger->list);
+    list_del(&passenger->queue);
+
+    // add the passenger to elevator list
+    list_add_tail(&passenger->list, &elevator_thread->elevator_list);
+    passenger->boarded = ktime_get();
+
+    elevator_thread->weight += passenger->weight;
+    elevator_thread->num_passengers++;
+    atomic_dec(&floors.num_passengers_waiting);
+    floors.curr_waiting[elevator_thread->current_floor - 1]--;
+    set_bit(elevator_thread->current_floor - 1, floors.stale_map);
+    remove_hall_call(elevator_thread, elevator_thread->current_floor);
+    add_car_call(elevator_thread, passenger->destination_floor);
+
+    trace_passenger_board(elevator_thread->id, passenger->type, elevator_thread->current_floor,
+                          passenger->destination_floor, elevator_thread->weight,
+                          elevator_thread->num_passengers,
+                          floors.curr_waiting[elevator_thread->current_floor - 1],
+                          ktime_us_delta(passenger->boarded, passenger->issued));
+    record_event(ELEVATOR_EVENT_BOARD, elevator_thread, elevator_thread->current_floor,
+                 passenger->destination_floor, passenger->id);
+}
+
+// Stops this car made at the rider's floor since the rider arrived. Riders
+// who arrived earlier were there for every one of them too, so the oldest
+// rider on a floor has always been skipped the most.
+static int times_skipped(struct Elevator *elevator_thread, struct Passenger *passenger)
+{
+    return elevator_thread->hall_stops[passenger->starting_floor - 1] - passenger->stops_seen;
+}
+
+// FIFO: board in arrival order, skipping whoever does not fit, which is
+// what walking the floor list would do
+static void board_fifo(struct Elevator *elevator_thread)
+{
+    struct Passenger *first;
+
+    while ((first = next_boarder(elevator_thread, elevator_thread->current_floor)))
+    {
+        board_passenger(elevator_thread, first);
+    }
+}
+
+// Tries every number of riders of each type from type_index on that fits
+// in the remaining slots and room, keeping the best in packing->best
+static void pack_search(struct Packing *packing, int type_index, int slots, int room, int riders, int weight)
+{
+    int better;
+
+    if (type_index == NUM_TYPES)
+    {
+        if (packing->by_weight)
+        {
+            better = weight > packing->best_weight ||
+                     (weight == packing->best_weight && riders > packing->best_riders);
+        }
+        else
+        {
+            better = riders > packing->best_riders ||
+                     (riders == packing->best_riders && weight > packing->best_weight);
+        }
+
+        if (better)
+        {
+            memcpy(packing->best, packing->counts, sizeof(packing->best));
+            packing->best_riders = riders;
+            packing->best_weight = weight;
+        }
+        return;
+    }
+
+    for (int count = 0; count <= packing->available[type_index] && count <= slots &&
+                        count * packing->weights[type_index] <= room;
+         ++count)
+    {
+        packing->counts[type_index] = count;
+        pack_search(packing, type_index + 1, slots - count, room - count * packing->weights[type_index],
+                    riders + count, weight + count * packing->weights[type_index]);
+    }
+}
+
+// Boards whoever has been skipped boarding_age times, oldest first, then
+// the mix of types that carries the most riders (or weight) in the space
+// left. Within a type the earliest arrivals board. With 5 slots and 4 types
+// there are at most 126 mixes to try.
+static void board_packed(struct Elevator *elevator_thread, int by_weight)
+{
+    int floor = elevator_thread->current_floor;
+    struct Packing packing = {.by_weight = by_weight};
+    struct Passenger *passenger, *next;
+    struct list_head *queue;
+
+    while ((passenger = next_boarder(elevator_thread, floor)) &&
+           times_skipped(elevator_thread, passenger) >= (int)READ_ONCE(boarding_age))
+    {
+        board_passenger(elevator_thread, passenger);
+    }
+
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        list_for_each_entry(passenger, hall_queue(elevator_thread, floor, i), queue)
+        {
+            packing.weights[i] = passenger->weight;
+            if (++packing.available[i] == 5)
+            {
+                break;
+            }
+        }
+    }
+
+    pack_search(&packing, 0, 5 - elevator_thread->num_passengers, 700 - elevator_thread->weight, 0, 0);
+
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        queue = hall_queue(elevator_thread, floor, i);
+        list_for_each_entry_safe(passenger, next, queue, queue)
+        {
+            if (packing.best[i]-- == 0)
+            {
+                break;
+            }
+            board_passenger(elevator_thread, passenger);
+        }
+    }
+}
+
+// Most riders per stop, heaviest mix on ties
+static void board_riders(struct Elevator *elevator_thread)
+{
+    board_packed(elevator_thread, 0);
+}
+
+// Most weight per stop, most riders on ties
+static void board_weight(struct Elevator *elevator_thread)
+{
+    board_packed(elevator_thread, 1);
+}
+
+static bool fits_on_board(struct Elevator *elevator_thread, struct Passenger *passenger)
+{
+    return elevator_thread->num_passengers < 5 && elevator_thread->weight + passenger->weight <= 700;
+}
+
+// Earliest arrival among the candidates bound for destination_floor who
+// fits, or NULL. Sets index to where it is in candidates.
+static struct Passenger *next_in_group(struct Elevator *elevator_thread, struct Passenger **candidates,
+                                       int num_candidates, int destination_floor, int *index)
+{
+    struct Passenger *best = NULL;
+
+    for (int i = 0; i < num_candidates; ++i)
+    {
+        if (candidates[i] && candidates[i]->destination_floor == destination_floor &&
+            fits_on_board(elevator_thread, candidates[i]) && (!best || candidates[i]->seq < best->seq))
+        {
+            best = candidates[i];
+            *index = i;
+        }
+    }
+
+    return best;
+}
+
+// Destination grouping: whoever has waited group_wait_us boards first,
+// oldest first. Then riders bound for a floor the car already stops at,
+// then the rest by destination, largest group first, earliest arrivals
+// first within a group. When not everyone fits, those left behind are the
+// ones who would have added the most stops.
+static void board_destination(struct Elevator *elevator_thread)
+{
+    int floor = elevator_thread->current_floor;
+    struct Passenger *candidates[NUM_TYPES * GROUP_SCAN];
+    struct Passenger *passenger, *chosen;
+    u64 wait_bound = READ_ONCE(group_wait_us) / max(READ_ONCE(time_scale), 1U);
+    int num_candidates = 0, scanned, count, chosen_count = 0, index;
+    bool stop, chosen_stop = false;
+
+    while ((passenger = next_boarder(elevator_thread, floor)) &&
+           ktime_us_delta(ktime_get(), passenger->issued) >= wait_bound)
+    {
+        board_passenger(elevator_thread, passenger);
+    }
+
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        scanned = 0;
+        list_for_each_entry(passenger, hall_queue(elevator_thread, floor, i), queue)
+        {
+            candidates[num_candidates++] = passenger;
+            if (++scanned == GROUP_SCAN)
+            {
+                break;
+            }
+        }
+    }
+
+    for (;;)
+    {
+        chosen = NULL;
+        for (int i = 0; i < num_candidates; ++i)
+        {
+            passenger = candidates[i];
+            if (!passenger || !fits_on_board(elevator_thread, passenger))
+            {
+                continue;
+            }
+
+            stop = test_bit(passenger->destination_floor - 1, elevator_thread->car_map);
+            count = 0;
+            for (int j = 0; j < num_candidates; ++j)
+            {
+                count += candidates[j] && candidates[j]->destination_floor == passenger->destination_floor &&
+                         fits_on_board(elevator_thread, candidates[j]);
+            }
+
+            if (!chosen || stop > chosen_stop ||
+                (stop == chosen_stop && (count > chosen_count ||
+                                         (count == chosen_count && passenger->seq < chosen->seq))))
+            {
+                chosen = passenger;
+                chosen_stop = stop;
+                chosen_count = count;
+            }
+        }
+
+        if (!chosen)
+        {
+            break;
+        }
+
+        while ((passenger = next_in_group(elevator_thread, candidates, num_candidates,
+                                          chosen->destination_floor, &index)))
+        {
+            board_passenger(elevator_thread, passenger);
+            candidates[index] = NULL;
+        }
+    }
+}
+
+/*===========================================================================*/
+/*==============================Trip Statistics==============================*/
+/*===========================================================================*/
+
+// Riders are timestamped when issued, boarded and dropped off. Each trip
+// is added to the histograms of its type and starting floor with atomic
+// operations only, so recording takes no lock and allocates nothing.
+
+// Buckets 0-3 hold 0-3 us exactly, after that every power of two is split
+// into 4 buckets by the two bits below the top one
+static int stats_bucket(u64 us)
+{
+    int msb = fls64(us) - 1;
+
+    if (us < 4)
+    {
+        return us;
+    }
+
+    return min((msb - 1) * 4 + (int)((us >> (msb - 2)) & 3), STATS_BUCKETS - 1);
+}
+
+// Largest value, in microseconds, that lands in the bucket
+static u64 bucket_limit(int bucket)
+{
+    if (bucket < 4)
+    {
+        return bucket;
+    }
+
+    return ((u64)(4 + bucket % 4 + 1) << (bucket / 4 - 1)) - 1;
+}
+
+static void histogram_add(struct Histogram *histogram, u64 us)
+{
+    s64 max = atomic64_read(&histogram->max_us);
+
+    atomic_inc(&histogram->buckets[stats_bucket(us)]);
+    atomic64_inc(&histogram->count);
+    atomic64_add(us, &histogram->sum_us);
+
+    while ((s64)us > max)
+    {
+        max = atomic64_cmpxchg(&histogram->max_us, max, us);
+    }
+}
+
+static void histogram_reset(struct Histogram *histogram)
+{
+    for (int i = 0; i < STATS_BUCKETS; ++i)
+    {
+        atomic_set(&histogram->buckets[i], 0);
+    }
+    atomic64_set(&histogram->count, 0);
+    atomic64_set(&histogram->sum_us, 0);
+    atomic64_set(&histogram->max_us, 0);
+}
+
+// Target trip time of the type in microseconds, scaled like travel_us
+static u64 trip_target_us(int type_index)
+{
+    return (u64)READ_ONCE(trip_targets_ms[type_index]) * 1000 / max(READ_ONCE(time_scale), 1U);
+}
+
+// When the rider's trip overruns its target
+static ktime_t trip_deadline(struct Passenger *passenger)
+{
+    return ktime_add_us(passenger->issued, trip_target_us(passenger->type_index));
+}
+
+// Called as the rider gets off
+static void record_trip(struct Passenger *passenger)
+{
+    u64 times[NUM_METRICS];
+
+    times[WAIT_TIME] = ktime_us_delta(passenger->boarded, passenger->issued);
+    times[RIDE_TIME] = ktime_us_delta(ktime_get(), passenger->boarded);
+    times[TRIP_TIME] = times[WAIT_TIME] + times[RIDE_TIME];
+
+    if (times[TRIP_TIME] > trip_target_us(passenger->type_index))
+    {
+        atomic64_inc(&slo_misses[passenger->type_index]);
+    }
+
+    for (int i = 0; i < NUM_METRICS; ++i)
+    {
+        histogram_add(&type_stats[passenger->type_index][i], times[i]);
+        histogram_add(&floor_stats[(passenger->starting_floor - 1) * NUM_METRICS + i], times[i]);
+    }
+}
+
+static void reset_trip_stats(void)
+{
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        for (int j = 0; j < NUM_METRICS; ++j)
+        {
+            histogram_reset(&type_stats[i][j]);
+        }
+        atomic64_set(&slo_misses[i], 0);
+    }
+
+    for (int i = 0; i < num_floors * NUM_METRICS; ++i)
+    {
+        histogram_reset(&floor_stats[i]);
+    }
+}
+
+/*===========================================================================*/
+/*============================Scheduling Policies============================*/
+/*===========================================================================*/
+
+// A hall call only counts if someone assigned to this car would fit on
+// board, and stops counting once the elevator is deactivating
+static int floor_has_hall_call(struct Elevator *elevator_thread, int floor)
+{
+    return !elevator_thread->deactivating && next_boarder(elevator_thread, floor) != NULL;
+}
+
+// Closest floor past the current one, in direction step, with a hall call
+// or (unless hall_only) a rider on board headed there. Returns 0 if none.
+static int closest_call_floor(struct Elevator *elevator_thread, int step, int hall_only)
+{
+    int current_floor = elevator_thread->current_floor;
+    int car_floor = 0;
+    int hall_floor = 0;
+
+    if (!hall_only)
+    {
+        car_floor = next_marked_floor(elevator_thread->car_map, current_floor, step);
+    }
+
+    if (!elevator_thread->deactivating && elevator_thread->num_passengers < 5)
+    {
+        // skip over hall calls nobody fits into
+        hall_floor = next_marked_floor(elevator_thread->hall_map, current_floor, step);
+        while (hall_floor && !floor_has_hall_call(elevator_thread, hall_floor))
+        {
+            if (car_floor && abs(hall_floor - current_floor) >= abs(car_floor - current_floor))
+            {
+                // the car call is closer anyway
+                hall_floor = 0;
+                break;
+            }
+            hall_floor = next_marked_floor(elevator_thread->hall_map, hall_floor, step);
+        }
+    }
+
+    if (!hall_floor || (car_floor && abs(car_floor - current_floor) <= abs(hall_floor - current_floor)))
+    {
+        return car_floor;
+    }
+
+    return hall_floor;
+}
+
+// Returns the direction of the closest call, preferring the current
+// direction on ties, or -1 if there is none
+static int closest_call_direction(struct Elevator *elevator_thread, int hall_only)
+{
+    int step = elevator_thread->direction ? 1 : -1;
+    int ahead = closest_call_floor(elevator_thread, step, hall_only);
+    int behind = closest_call_floor(elevator_thread, -step, hall_only);
+
+    if (!ahead && !behind)
+    {
+        return -1;
+    }
+
+    if (ahead && (!behind || abs(ahead - elevator_thread->current_floor) <=
+                                 abs(behind - elevator_thread->current_floor)))
+    {
+        return elevator_thread->direction;
+    }
+
+    return !elevator_thread->direction;
+}
+
+// SCAN: sweep all the way to the top or bottom floor before reversing
+static int scan_direction(struct Elevator *elevator_thread)
+{
+    if (elevator_thread->current_floor == num_floors)
+    {
+        return 0;
+    }
+    if (elevator_thread->current_floor == 1)
+    {
+        return 1;
+    }
+
+    return elevator_thread->direction;
+}
+
+// LOOK: keep going while there is a call ahead, otherwise reverse
+static int look_direction(struct Elevator *elevator_thread)
+{
+    int step = elevator_thread->direction ? 1 : -1;
+
+    if (closest_call_floor(elevator_thread, step, 0))
+    {
+        return elevator_thread->direction;
+    }
+
+    return !elevator_thread->direction;
+}
+
+// Nearest request: head for the closest waiting rider that fits, and only
+// chase drop-offs when nobody else can be picked up
+static int nearest_direction(struct Elevator *elevator_thread)
+{
+    int direction = closest_call_direction(elevator_thread, 1);
+
+    if (direction < 0)
+    {
+        direction = closest_call_direction(elevator_thread, 0);
+    }
+
+    return direction < 0 ? scan_direction(elevator_thread) : direction;
+}
+
+// Whether the rider can still be dropped off by their deadline with
+// distance floors left to travel, at travel_us a floor and stopping nowhere
+static bool can_meet_deadline(struct Passenger *passenger, int distance, ktime_t now)
+{
+    return ktime_before(ktime_add_us(now, (u64)distance * READ_ONCE(travel_us) / max(READ_ONCE(time_scale), 1U)),
+                        trip_deadline(passenger));
+}
+
+// Furthest floor in direction step with a call of either kind, or the
+// current floor when there is none
+static int last_call_floor(struct Elevator *elevator_thread, int step)
+{
+    int floor = elevator_thread->current_floor;
+    const unsigned long *maps[] = {elevator_thread->car_map, elevator_thread->hall_map};
+    unsigned long bit;
+
+    for (int i = 0; i < ARRAY_SIZE(maps); ++i)
+    {
+        bit = step > 0 ? find_last_bit(maps[i], num_floors) : find_next_bit(maps[i], num_floors, 0);
+        if (bit < num_floors && (int)(bit + 1 - floor) * step > 0)
+        {
+            floor = bit + 1;
+        }
+    }
+
+    return floor;
+}
+
+// Floors travelled from floor to target by a car sweeping in direction step
+// out to turn_floor before coming back
+static int sweep_distance(int floor, int target, int step, int turn_floor)
+{
+    if ((target - floor) * step >= 0)
+    {
+        return abs(target - floor);
+    }
+
+    return abs(turn_floor - floor) + abs(turn_floor - target);
+}
+
+// Earliest deadline first, on top of LOOK: the car sweeps as LOOK would as
+// long as that meets every deadline it still can. Otherwise it heads for
+// the rider with the earliest deadline among those the sweep would make
+// late, on board or waiting and fitting. Riders who will be late whatever
+// the car does are left to the sweep rather than chased, or one late rider
+// would make everyone after them late too. The head of each hall queue has
+// the earliest deadline of its type and floor, so only heads are checked.
+static int edf_direction(struct Elevator *elevator_thread)
+{
+    int current_floor = elevator_thread->current_floor;
+    int direction = look_direction(elevator_thread);
+    int step = direction ? 1 : -1;
+    int turn_floor = last_call_floor(elevator_thread, step);
+    int target = 0, floor = 0, ride;
+    struct Passenger *passenger;
+    ktime_t earliest = 0, deadline, now = ktime_get();
+
+    list_for_each_entry(passenger, &elevator_thread->elevator_list, list)
+    {
+        deadline = trip_deadline(passenger);
+        if ((!target || ktime_before(deadline, earliest)) &&
+            can_meet_deadline(passenger, abs(passenger->destination_floor - current_floor), now) &&
+            !can_meet_deadline(passenger, sweep_distance(current_floor, passenger->destination_floor, step,
+                                                         turn_floor), now))
+        {
+            target = passenger->destination_floor;
+            earliest = deadline;
+        }
+    }
+
+    if (!elevator_thread->deactivating && elevator_thread->num_passengers < 5)
+    {
+        // other floors are only peeked at, as in next_boarder()
+        while ((floor = next_marked_floor(elevator_thread->hall_map, floor, 1)))
+        {
+            for (int i = 0; i < NUM_TYPES; ++i)
+            {
+                passenger = list_first_entry_or_null(hall_queue(elevator_thread, floor, i),
+                                                     struct Passenger, queue);
+                if (!passenger || elevator_thread->weight + passenger->weight > 700)
+                {
+                    continue;
+                }
+
+                deadline = trip_deadline(passenger);
+                ride = abs(passenger->destination_floor - floor);
+                if ((!target || ktime_before(deadline, earliest)) &&
+                    can_meet_deadline(passenger, abs(floor - current_floor) + ride, now) &&
+                    !can_meet_deadline(passenger, sweep_distance(current_floor, floor, step, turn_floor) + ride,
+                                       now))
+                {
+                    target = floor;
+                    earliest = deadline;
+                }
+            }
+        }
+    }
+
+    if (!target || target == current_floor)
+    {
+        return direction;
+    }
+
+    return target > current_floor;
+}
+
+// Shortest seek time first: head for the closest call of any kind
+static int sstf_direction(struct Elevator *elevator_thread)
+{
+    int direction = closest_call_direction(elevator_thread, 0);
+
+    return direction < 0 ? scan_direction(elevator_thread) : direction;
+}
+
+/*===========================================================================*/
+/*=============================Elevator Movement=============================*/
+/*===========================================================================*/
+
+// Every state change goes through here so it shows up as elevator:elevator_state
+// and on /proc/elevator_events
+static void set_state(struct Elevator *elevator_thread, enum elevator_state state)
+{
+    trace_elevator_state(elevator_thread->id, elevator_thread->current_state, state,
+                         elevator_thread->current_floor, elevator_thread->weight,
+                         elevator_thread->num_passengers, atomic_read(&floors.num_passengers_waiting));
+    record_event(ELEVATOR_EVENT_STATE, elevator_thread, elevator_thread->current_floor, state, 0);
+    elevator_thread->current_state = state;
+}
+
+// Moves one floor up (direction 1) or down (0)
+static void step_floor(struct Elevator *elevator_thread, int direction)
+{
+    if (direction)
+    {
+        set_state(elevator_thread, UP);
+        elevator_thread->current_floor++;
+        elevator_thread->direction = 1;
+    }
+    else
+    {
+        set_state(elevator_thread, DOWN);
+        elevator_thread->current_floor--;
+        elevator_thread->direction = 0;
+    }
+}
+
+// Moves one floor in the direction picked by the active policy. Anyone to
+// serve ends a trip to a parking floor.
+static void depart_floor(struct Elevator *elevator_thread)
+{
+    int direction = READ_ONCE(active_policy)->next_direction(elevator_thread);
+
+    if (elevator_thread->current_floor == num_floors)
+    {
+        direction = 0;
+    }
+    else if (elevator_thread->current_floor == 1)
+    {
+        direction = 1;
+    }
+
+    WRITE_ONCE(elevator_thread->park_floor, 0);
+    step_floor(elevator_thread, direction);
+}
+
+// Takes the car's mutex, then the lock of the floor it is at and no other
+void move_elevator(struct Elevator *elevator_thread)
+{
+    int floor;
+
+    switch (elevator_thread->current_state)
+    {
+    case IDLE:
+        // kicked because a passenger was assigned to this car, or the car
+        // is stopped
+        if (elevator_thread->deactivating)
+        {
+            mutex_lock(&elevator_thread->elevator_mutex);
+            set_state(elevator_thread, OFFLINE);
+            elevator_thread->initialized = 0;
+            mutex_unlock(&elevator_thread->elevator_mutex);
+        }
+        else
+        {
+            mutex_lock(&elevator_thread->elevator_mutex);
+            floor = elevator_thread->current_floor;
+            mutex_lock(floor_lock(floor));
+            if (atomic_read(&elevator_thread->num_assigned) > 0)
+            {
+                if (can_load_passenger(elevator_thread) || can_unload_passenger(elevator_thread))
+                {
+                    set_state(elevator_thread, LOADING);
+                }
+                else
+                {
+                    depart_floor(elevator_thread);
+                }
+            }
+            unlock_floor(floor);
+            mutex_unlock(&elevator_thread->elevator_mutex);
+        }
+
+        break;
+
+    case LOADING:
+        mutex_lock(&elevator_thread->elevator_mutex);
+        floor = elevator_thread->current_floor;
+        mutex_lock(floor_lock(floor));
+        if (can_unload_passenger(elevator_thread))
+        {
+            unload_passenger(elevator_thread);
+        }
+
+        if (can_load_passenger(elevator_thread) && !elevator_thread->deactivating)
+        {
+            load_passenger(elevator_thread);
+        }
+
+        if (elevator_thread->num_passengers > 0 || (atomic_read(&elevator_thread->num_assigned) > 0 && !elevator_thread->deactivating))
+        {
+            depart_floor(elevator_thread);
+        }
+        else
+        {
+            park_or_idle(elevator_thread);
+        }
+
+        unlock_floor(floor);
+        mutex_unlock(&elevator_thread->elevator_mutex);
+        break;
+
+    case UP:
+        mutex_lock(&elevator_thread->elevator_mutex);
+        floor = elevator_thread->current_floor;
+        mutex_lock(floor_lock(floor));
+
+        if ((can_load_passenger(elevator_thread) && !elevator_thread->deactivating) ||
+            can_unload_passenger(elevator_thread))
+        {
+            set_state(elevator_thread, LOADING);
+        }
+        else
+        {
+            if ((atomic_read(&elevator_thread->num_assigned) > 0 && !elevator_thread->deactivating) || elevator_thread->num_passengers > 0)
+            {
+                depart_floor(elevator_thread);
+            }
+            else
+            {
+                park_or_idle(elevator_thread);
+            }
+        }
+
+        unlock_floor(floor);
+        mutex_unlock(&elevator_thread->elevator_mutex);
+        break;
+
+    case DOWN:
+        mutex_lock(&elevator_thread->elevator_mutex);
+        floor = elevator_thread->current_floor;
+        mutex_lock(floor_lock(floor));
+        if ((can_load_passenger(elevator_thread) && !elevator_thread->deactivating) ||
+            can_unload_passenger(elevator_thread))
+        {
+            set_state(elevator_thread, LOADING);
+        }
+        else
+        {
+            if ((atomic_read(&elevator_thread->num_assigned) > 0 && !elevator_thread->deactivating) || elevator_thread->num_passengers > 0)
+            {
+                depart_floor(elevator_thread);
+            }
+            else
+            {
+                park_or_idle(elevator_thread);
+            }
+        }
+
+        unlock_floor(floor);
+        mutex_unlock(&elevator_thread->elevator_mutex);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Arms the timer for the car's next step, which finishes the state it is in
+// now: the dwell at a floor for LOADING, a floor's travel for UP and DOWN,
+// both divided by time_scale. An IDLE car steps again at once if it has
+// something to do and otherwise waits to be kicked; an OFFLINE one stays put.
+static void schedule_step(struct Elevator *elevator_thread)
+{
+    unsigned int us;
+
+    if (READ_ONCE(elevators_unloading))
+    {
+        return;
+    }
+
+    switch (elevator_thread->current_state)
+    {
+    case LOADING:
+        us = READ_ONCE(dwell_us);
+        break;
+
+    case UP:
+    case DOWN:
+        us = READ_ONCE(travel_us);
+        break;
+
     case IDLE:
-        ssleep(1);
+        if (atomic_read(&elevator_thread->num_assigned) > 0 ||
+            READ_ONCE(elevator_thread->deactivating) || rings_pending())
+        {
+            queue_work(elevator_wq, &elevator_thread->work);
+        }
+        return;
 
-        if (elevator_thread->deactivating)
+    default:
+        return;
+    }
+
+    elevator_thread->due = ktime_add_us(ktime_get(), us / max(READ_ONCE(time_scale), 1U));
+    hrtimer_start_range_ns(&elevator_thread->timer, elevator_thread->due,
+                           DELAY_SLACK_US * NSEC_PER_USEC, HRTIMER_MODE_ABS);
+}
+
+// Steps an idle car now. A car that is moving or loading sees new
+// passengers when its timer fires, so it is left alone.
+static void kick_elevator(struct Elevator *elevator_thread)
+{
+    if (READ_ONCE(elevator_thread->current_state) == IDLE)
+    {
+        queue_work(elevator_wq, &elevator_thread->work);
+    }
+}
+
+// Runs in hard interrupt context, so the step itself is left to the work
+static enum hrtimer_restart elevator_timer(struct hrtimer *timer)
+{
+    struct Elevator *elevator_thread = container_of(timer, struct Elevator, timer);
+
+    queue_work(elevator_wq, &elevator_thread->work);
+    return HRTIMER_NORESTART;
+}
+
+static void elevator_work(struct work_struct *work)
+{
+    struct Elevator *elevator_thread = container_of(work, struct Elevator, work);
+
+    // queued by a timer or a kick that raced with stop_cars(), the building
+    // is being torn down under it
+    if (READ_ONCE(elevators_unloading))
+    {
+        return;
+    }
+
+    // a kick that raced with the car leaving IDLE must not cut its travel
+    // or dwell short, the timer will queue the real step
+    if (READ_ONCE(elevator_thread->current_state) != IDLE &&
+        ktime_before(ktime_get(), elevator_thread->due))
+    {
+        return;
+    }
+
+    poll_rings();
+    move_elevator(elevator_thread);
+    publish_snapshots(elevator_thread);
+    schedule_step(elevator_thread);
+}
+
+/*===========================================================================*/
+/*=============================Parking Functions=============================*/
+/*===========================================================================*/
+
+// Folds the arrivals counted in the open window into the rates for its
+// hour and opens window. Hours in between had no arrivals and fold in as
+// zeros, a day's worth at most.
+static void roll_parking_window(u64 window)
+{
+    u64 open, first;
+    u32 sample, *rate;
+    int bucket;
+
+    spin_lock(&parking_lock);
+    open = parking_window;
+    if (window <= open)
+    {
+        // another caller got here first
+        spin_unlock(&parking_lock);
+        return;
+    }
+
+    first = max(open, window - min_t(u64, window, PARKING_BUCKETS));
+    for (u64 w = first; w < window; ++w)
+    {
+        bucket = w % PARKING_BUCKETS;
+        for (int i = 0; i < num_floors; ++i)
         {
-            mutex_lock_interruptible(&elevator_thread->elevator_mutex);
-            elevator_thread->current_state = OFFLINE;
-            elevator_thread->initialized = 0;
-            mutex_unlock(&elevator_thread->elevator_mutex);
-            kthread_stop(elevator_thread->thread);
+            sample = w == open ? atomic_xchg(&parking_arrivals[i], 0) * RATE_SCALE : 0;
+            rate = &parking_rates[bucket * num_floors + i];
+            if (test_bit(bucket, &parking_learned))
+            {
+                sample = ((((u64)*rate) << PARKING_EWMA_SHIFT) - *rate + sample +
+                          (1 << (PARKING_EWMA_SHIFT - 1))) >> PARKING_EWMA_SHIFT;
+            }
+            WRITE_ONCE(*rate, sample);
         }
-        else
+        set_bit(bucket, &parking_learned);
+    }
+
+    if (first > open)
+    {
+        // over a day since the open window, its counts are too old to use
+        for (int i = 0; i < num_floors; ++i)
+        {
+            atomic_set(&parking_arrivals[i], 0);
+        }
+    }
+    WRITE_ONCE(parking_window, window);
+    spin_unlock(&parking_lock);
+}
+
+// Counts a new rider towards the rates for their floor
+static void record_arrival(int floor)
+{
+    u64 window = ktime_get_real_seconds() / PARKING_WINDOW_S;
+
+    if (window != READ_ONCE(parking_window))
+    {
+        roll_parking_window(window);
+    }
+    atomic_inc(&parking_arrivals[floor - 1]);
+}
+
+// The rates to park by: this hour's, or those of the latest hour learned
+// when this one has no history yet. Sets bucket to the hour used. Returns
+// NULL until the first window has closed.
+static const u32 *parking_rates_now(int *bucket)
+{
+    u64 window = ktime_get_real_seconds() / PARKING_WINDOW_S;
+    unsigned long learned;
+
+    if (window != READ_ONCE(parking_window))
+    {
+        roll_parking_window(window);
+    }
+
+    learned = READ_ONCE(parking_learned);
+    for (int i = 0; i < PARKING_BUCKETS; ++i)
+    {
+        *bucket = (window + PARKING_BUCKETS - i) % PARKING_BUCKETS;
+        if (test_bit(*bucket, &learned))
+        {
+            return &parking_rates[*bucket * num_floors];
+        }
+    }
+
+    return NULL;
+}
+
+// Picks the floor for an idle car to wait at, the one that minimizes the
+// expected distance to the next caller. Each floor is weighted by its rate
+// and counts as covered by another idle car when that one is closer, so
+// cars spread out. Caller holds the car's mutex; the other cars are only
+// peeked at.
+static int choose_park_floor(struct Elevator *car)
+{
+    int current_floor = car->current_floor;
+    int best = current_floor;
+    u64 total = 0, cost, best_cost = U64_MAX, stay_cost = 0;
+    u32 *cover = car->park_cover;
+    struct Elevator *other;
+    const u32 *rates;
+    int bucket, home;
+
+    rates = parking_rates_now(&bucket);
+    if (!rates)
+    {
+        return current_floor;
+    }
+
+    for (int i = 0; i < num_floors; ++i)
+    {
+        cover[i] = U32_MAX;
+        total += READ_ONCE(rates[i]);
+    }
+    if (!total)
+    {
+        return current_floor;
+    }
+
+    // where every other car not busy serving anyone is or will be waiting
+    for (int i = 0; i < num_cars; ++i)
+    {
+        other = &elevators[i];
+        home = READ_ONCE(other->park_floor);
+        if (!home && READ_ONCE(other->current_state) == IDLE)
+        {
+            home = READ_ONCE(other->current_floor);
+        }
+        if (other == car || !home)
+        {
+            continue;
+        }
+
+        for (int j = 0; j < num_floors; ++j)
+        {
+            cover[j] = min_t(u32, cover[j], abs(home - (j + 1)));
+        }
+    }
+
+    for (int floor = 1; floor <= num_floors; ++floor)
+    {
+        cost = 0;
+        for (int j = 0; j < num_floors; ++j)
+        {
+            cost += (u64)READ_ONCE(rates[j]) * min_t(u32, cover[j], abs(floor - (j + 1)));
+        }
+
+        if (floor == current_floor)
+        {
+            stay_cost = cost;
+        }
+        // ties go to the floor closest to the car
+        if (cost < best_cost || (cost == best_cost && abs(floor - current_floor) < abs(best - current_floor)))
+        {
+            best = floor;
+            best_cost = cost;
+        }
+    }
+
+    car->parked.from = current_floor;
+    car->parked.to = best;
+    car->parked.cost_from = stay_cost * 100 / total;
+    car->parked.cost_to = best_cost * 100 / total;
+    atomic64_inc(&parking_decisions);
+    if (best != current_floor)
+    {
+        atomic64_inc(&parking_moves);
+        atomic64_add(abs(best - current_floor), &parking_floors);
+    }
+
+    return best;
+}
+
+// For a car left with nobody to serve. With parking set it picks a floor
+// to wait at once per idle spell and moves towards it a floor per step,
+// until it is there or someone needs it. Otherwise the car goes IDLE where
+// it is. Caller holds the car's mutex.
+static void park_or_idle(struct Elevator *car)
+{
+    if (!car->park_floor && READ_ONCE(parking) && !car->deactivating)
+    {
+        WRITE_ONCE(car->park_floor, choose_park_floor(car));
+    }
+
+    if (car->park_floor == car->current_floor || car->deactivating || !READ_ONCE(parking))
+    {
+        WRITE_ONCE(car->park_floor, 0);
+    }
+
+    if (!car->park_floor)
+    {
+        set_state(car, IDLE);
+        return;
+    }
+
+    step_floor(car, car->park_floor > car->current_floor);
+}
+
+/*===========================================================================*/
+/*============================Snapshot Functions=============================*/
+/*===========================================================================*/
+
+// Copies the car for /proc/elevator. Caller holds the car's mutex. Without
+// memory the last snapshot stays up, a step behind.
+static int publish_car(struct Elevator *car)
+{
+    struct CarSnapshot *snapshot, *old;
+    struct Passenger *passenger;
+    int i = 0;
+
+    lockdep_assert_held(&car->elevator_mutex);
+
+    snapshot = kmalloc(struct_size(snapshot, riders, car->num_passengers), GFP_KERNEL);
+    if (!snapshot)
+    {
+        return -ENOMEM;
+    }
+
+    snapshot->state = car->current_state;
+    snapshot->floor = car->current_floor;
+    snapshot->weight = car->weight;
+    snapshot->assigned = atomic_read(&car->num_assigned);
+    if (car->initialized)
+    {
+        list_for_each_entry(passenger, &car->elevator_list, list)
+        {
+            snapshot->riders[i].type = passenger->type;
+            snapshot->riders[i].destination_floor = passenger->destination_floor;
+            i++;
+        }
+    }
+    snapshot->num_riders = i;
+
+    old = rcu_replace_pointer(car->snapshot, snapshot, lockdep_is_held(&car->elevator_mutex));
+    if (old)
+    {
+        kfree_rcu(old, rcu);
+    }
+    return 0;
+}
+
+// Copies the floor's count and its first SNAPSHOT_RIDERS riders for
+// /proc/elevator, so a step never copies a whole backed-up queue while
+// submitters wait for the lock. Caller holds the floor's lock.
+static int publish_floor(int floor)
+{
+    int num_riders = min(floors.curr_waiting[floor - 1], SNAPSHOT_RIDERS);
+    struct FloorSnapshot *snapshot, *old;
+    struct Passenger *passenger;
+    int i = 0;
+
+    lockdep_assert_held(floor_lock(floor));
+
+    snapshot = kmalloc(struct_size(snapshot, riders, num_riders), GFP_KERNEL);
+    if (!snapshot)
+    {
+        return -ENOMEM;
+    }
+
+    if (floors.initialized)
+    {
+        list_for_each_entry(passenger, &floors.floor_lists[floor - 1], list)
         {
-            mutex_lock_interruptible(&floors.floors_mutex);
-            mutex_lock_interruptible(&elevator_thread->elevator_mutex);
-            if (floors.num_passengers_waiting > 0)
+            if (i == num_riders)
             {
-                if (can_load_passenger(elevator_thread) || can_unload_passenger(elevator_thread))
-                {
-                    elevator_thread->current_state = LOADING;
-                }
-                else
-                {
-                    if ((elevator_thread->direction && elevator_thread->current_floor != 5) ||
-                        (!elevator_thread->direction && elevator_thread->current_floor == 1))
-                    {
-                        elevator_thread->current_state = UP;
-                        elevator_thread->current_floor++;
-                        elevator_thread->direction = 1;
-                    }
-                    else
-                    {
-                        elevator_thread->current_state = DOWN;
-                        elevator_thread->current_floor--;
-                        elevator_thread->direction = 0;
-                    }
-                }
+                break;
             }
-            mutex_unlock(&elevator_thread->elevator_mutex);
-            mutex_unlock(&floors.floors_mutex);
+            snapshot->riders[i].type = passenger->type;
+            snapshot->riders[i].destination_floor = passenger->destination_floor;
+            i++;
+        }
+    }
+    snapshot->num_waiting = floors.curr_waiting[floor - 1];
+    snapshot->num_riders = i;
+
+    old = rcu_replace_pointer(floors.snapshots[floor - 1], snapshot,
+                              lockdep_is_held(floor_lock(floor)));
+    if (old)
+    {
+        kfree_rcu(old, rcu);
+    }
+    return 0;
+}
+
+// Run at the end of every step: republishes the car, then every floor
+// changed since the last step of any car. A floor is copied at most once
+// per step however many riders were queued there in between, so a long
+// queue is not copied on every enqueue.
+static void publish_snapshots(struct Elevator *car)
+{
+    int floor;
+
+    mutex_lock(&car->elevator_mutex);
+    publish_car(car);
+    mutex_unlock(&car->elevator_mutex);
+
+    for (floor = find_next_bit(floors.stale_map, num_floors, 0); floor < num_floors;
+         floor = find_next_bit(floors.stale_map, num_floors, floor + 1))
+    {
+        if (!test_and_clear_bit(floor, floors.stale_map))
+        {
+            continue;
+        }
+
+        mutex_lock(floor_lock(floor + 1));
+        if (publish_floor(floor + 1))
+        {
+            // try again next step
+            set_bit(floor, floors.stale_map);
+        }
+        unlock_floor(floor + 1);
+    }
+}
+
+/*===========================================================================*/
+/*============================Proc File Function=============================*/
+/*===========================================================================*/
+
+// /proc/elevator is a sequence of records: the policy, one per car, one per
+// floor from the top down, then the totals. Cars and floors are rendered
+// from their snapshots under rcu_read_lock() and the totals from counters,
+// so a reader takes no lock the cars or submitters take, and seq_file
+// copies the output out in pages.
+
+static int num_records(void)
+{
+    return 1 + num_cars + num_floors + 1;
+}
+
+static void *elevator_seq_start(struct seq_file *m, loff_t *pos)
+{
+    // record n is returned as n + 1, NULL ends the sequence
+    return *pos < num_records() ? (void *)(uintptr_t)(*pos + 1) : NULL;
+}
+
+static void *elevator_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    ++*pos;
+    return elevator_seq_start(m, pos);
+}
+
+static void elevator_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+static void show_car(struct seq_file *m, struct Elevator *car)
+{
+    struct CarSnapshot *snapshot;
+
+    rcu_read_lock();
+    snapshot = rcu_dereference(car->snapshot);
+    seq_puts(m, "\n");
+
+    switch (snapshot->state)
+    {
+    case OFFLINE:
+        seq_printf(m, "Elevator %d state: %s\n", car->id + 1, "OFFLINE");
+        break;
+    case IDLE:
+        seq_printf(m, "Elevator %d state: %s\n", car->id + 1, "IDLE");
+        break;
+    case LOADING:
+        seq_printf(m, "Elevator %d state: %s\n", car->id + 1, "LOADING");
+        break;
+    case UP:
+        seq_printf(m, "Elevator %d state: %s\n", car->id + 1, "UP");
+        break;
+    case DOWN:
+        seq_printf(m, "Elevator %d state: %s\n", car->id + 1, "DOWN");
+        break;
+    }
+
+    seq_printf(m, "Elevator %d floor: %d\n", car->id + 1, snapshot->floor);
+    seq_printf(m, "Elevator %d load: %d\n", car->id + 1, snapshot->weight);
+    seq_printf(m, "Elevator %d assigned: %d\n", car->id + 1, snapshot->assigned);
+    seq_printf(m, "Elevator %d status: ", car->id + 1);
+
+    for (int i = 0; i < snapshot->num_riders; ++i)
+    {
+        seq_printf(m, "%c%d ", snapshot->riders[i].type, snapshot->riders[i].destination_floor);
+    }
+
+    seq_puts(m, "\n");
+    rcu_read_unlock();
+}
+
+static void show_floor(struct seq_file *m, int floor)
+{
+    struct FloorSnapshot *snapshot;
+    int car_here = 0;
+
+    if (floor == num_floors)
+    {
+        seq_puts(m, "\n");
+    }
+
+    rcu_read_lock();
+    for (int i = 0; i < num_cars; ++i)
+    {
+        if (rcu_dereference(elevators[i].snapshot)->floor == floor)
+        {
+            car_here = 1;
+        }
+    }
+
+    snapshot = rcu_dereference(floors.snapshots[floor - 1]);
+    seq_printf(m, "%s Floor %d: %d", car_here ? "[*]" : "[ ]", floor, snapshot->num_waiting);
+    for (int i = 0; i < snapshot->num_riders; ++i)
+    {
+        seq_printf(m, " %c%d", snapshot->riders[i].type, snapshot->riders[i].destination_floor);
+    }
+    if (snapshot->num_riders < snapshot->num_waiting)
+    {
+        seq_puts(m, " ...");
+    }
+
+    seq_puts(m, "\n");
+    rcu_read_unlock();
+}
+
+static void show_totals(struct seq_file *m)
+{
+    int num_passengers = 0;
+    int num_serviced = 0;
+    s64 allocs = atomic64_read(&passenger_allocs);
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        num_passengers += READ_ONCE(elevators[i].num_passengers);
+        num_serviced += READ_ONCE(elevators[i].num_serviced);
+    }
+
+    seq_printf(m, "\nNumber of passengers: %d\n", num_passengers);
+    seq_printf(m, "Number of passengers waiting: %d\n", atomic_read(&floors.num_passengers_waiting));
+    seq_printf(m, "Number of passengers serviced: %d\n", num_serviced);
+    seq_printf(m, "Passenger allocations: %lld (%lld ns average)\n", allocs,
+               allocs ? atomic64_read(&passenger_alloc_ns) / allocs : 0);
+    seq_printf(m, "Ring requests: %lld (%lld doorbells)\n", atomic64_read(&ring_requests),
+               atomic64_read(&ring_doorbells));
+    seq_printf(m, "Events: %llu (%lld lost by slow readers)\n", READ_ONCE(events_written),
+               atomic64_read(&events_lost));
+}
+
+static int elevator_seq_show(struct seq_file *m, void *v)
+{
+    int record = (uintptr_t)v - 1;
+
+    if (record == 0)
+    {
+        seq_printf(m, "Scheduling policy: %s\n", READ_ONCE(active_policy)->name);
+        if (READ_ONCE(active_boarding)->board == board_destination)
+        {
+            seq_printf(m, "Boarding: destination (delayed at most %u ms to group stops)\n",
+                       READ_ONCE(group_wait_us) / 1000);
+        }
+        else
+        {
+            seq_printf(m, "Boarding: %s (left behind at most %u times)\n",
+                       READ_ONCE(active_boarding)->name, READ_ONCE(boarding_age));
         }
+    }
+    else if (record <= num_cars)
+    {
+        show_car(m, &elevators[record - 1]);
+    }
+    else if (record <= num_cars + num_floors)
+    {
+        show_floor(m, num_floors - (record - num_cars - 1));
+    }
+    else
+    {
+        show_totals(m);
+    }
+
+    return 0;
+}
+
+// /proc/elevator_stats has a record per metric heading, then one per
+// passenger type and one per starting floor under it. Percentiles are the
+// upper bound of the bucket they fall in. Writing anything to the file
+// resets every histogram.
+
+// A heading and a row per type and floor for every metric, then a heading
+// and a row per type for the trip targets
+static int num_stats_records(void)
+{
+    return NUM_METRICS * (1 + NUM_TYPES + num_floors) + 1 + NUM_TYPES;
+}
+
+static void *stats_seq_start(struct seq_file *m, loff_t *pos)
+{
+    // record n is returned as n + 1, NULL ends the sequence
+    return *pos < num_stats_records() ? (void *)(uintptr_t)(*pos + 1) : NULL;
+}
 
-        break;
+static void *stats_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    ++*pos;
+    return stats_seq_start(m, pos);
+}
 
-    case LOADING:
-        ssleep(1);
+static void stats_seq_stop(struct seq_file *m, void *v)
+{
+}
 
-        mutex_lock_interruptible(&elevator_thread->elevator_mutex);
-        mutex_lock_interruptible(&floors.floors_mutex);
-        if (can_unload_passenger(elevator_thread))
-        {
-            unload_passenger(elevator_thread);
-        }
+static void show_histogram(struct seq_file *m, const char *label, struct Histogram *histogram)
+{
+    static const int percents[] = {50, 90, 99};
+    int buckets[STATS_BUCKETS];
+    u64 total = 0;
+    u64 seen = 0;
+    u64 max = atomic64_read(&histogram->max_us);
+    u64 value;
+    int bucket = 0;
+
+    // work from a copy so the percentiles agree with each other
+    for (int i = 0; i < STATS_BUCKETS; ++i)
+    {
+        buckets[i] = atomic_read(&histogram->buckets[i]);
+        total += buckets[i];
+    }
 
-        if (can_load_passenger(elevator_thread) && !elevator_thread->deactivating)
-        {
-            load_passenger(elevator_thread);
-        }
+    seq_printf(m, "%-11s %10llu", label, total);
+    if (!total)
+    {
+        seq_puts(m, "\n");
+        return;
+    }
 
-        if (elevator_thread->num_passengers > 0 || (floors.num_passengers_waiting > 0 && !elevator_thread->deactivating))
-        {
-            if (elevator_thread->direction)
-            {
-                if (elevator_thread->current_floor != 5)
-                {
-                    elevator_thread->current_floor++;
-                    elevator_thread->current_state = UP;
-                }
-                else
-                {
-                    elevator_thread->current_state = DOWN;
-                    elevator_thread->current_floor--;
-                    elevator_thread->direction = 0;
-                }
-            }
-            else
-            {
-                if (elevator_thread->current_floor != 1)
-                {
-                    elevator_thread->current_floor--;
-                    elevator_thread->current_state = DOWN;
-                }
-                else
-                {
-                    elevator_thread->current_state = UP;
-                    elevator_thread->current_floor++;
-                    elevator_thread->direction = 1;
-                }
-            }
-        }
-        else
+    value = atomic64_read(&histogram->sum_us) / total;
+    seq_printf(m, " %10llu.%03llu", value / 1000, value % 1000);
+
+    for (int i = 0; i < ARRAY_SIZE(percents); ++i)
+    {
+        while (seen + buckets[bucket] < DIV_ROUND_UP(total * percents[i], 100))
         {
-            elevator_thread->current_state = IDLE;
+            seen += buckets[bucket++];
         }
+        value = min(bucket_limit(bucket), max);
+        seq_printf(m, " %10llu.%03llu", value / 1000, value % 1000);
+    }
 
-        mutex_unlock(&elevator_thread->elevator_mutex);
-        mutex_unlock(&floors.floors_mutex);
-        break;
+    seq_printf(m, " %10llu.%03llu\n", max / 1000, max % 1000);
+}
 
-    case UP:
-        ssleep(2);
+static void show_slo(struct seq_file *m, int type_index)
+{
+    u64 trips = atomic64_read(&type_stats[type_index][TRIP_TIME].count);
+    u64 misses = atomic64_read(&slo_misses[type_index]);
+    u64 permille = trips ? misses * 1000 / trips : 0;
 
-        mutex_lock_interruptible(&elevator_thread->elevator_mutex);
-        mutex_lock_interruptible(&floors.floors_mutex);
+    seq_printf(m, "type %c      %10u %10llu %10llu %6llu.%llu%%\n", "PLBV"[type_index],
+               READ_ONCE(trip_targets_ms[type_index]), trips, misses, permille / 10, permille % 10);
+}
 
-        if ((can_load_passenger(elevator_thread) && !elevator_thread->deactivating) ||
-            can_unload_passenger(elevator_thread))
+static int stats_seq_show(struct seq_file *m, void *v)
+{
+    static const char *const headings[] = {
+        [WAIT_TIME] = "Wait time (ms), issue to board",
+        [RIDE_TIME] = "Ride time (ms), board to drop-off",
+        [TRIP_TIME] = "Trip time (ms), issue to drop-off",
+    };
+    int record = (uintptr_t)v - 1;
+    int per_metric = 1 + NUM_TYPES + num_floors;
+    int metric = record / per_metric;
+    int row = record % per_metric;
+    char label[32];
+
+    if (metric == NUM_METRICS)
+    {
+        if (row == 0)
         {
-            elevator_thread->current_state = LOADING;
+            seq_printf(m, "\nTrip targets, policy %s\n%-11s %10s %10s %10s %9s\n",
+                       READ_ONCE(active_policy)->name, "", "target ms", "trips", "missed", "of trips");
         }
         else
         {
-            if ((floors.num_passengers_waiting > 0 && !elevator_thread->deactivating) || elevator_thread->num_passengers > 0)
-            {
-                if (elevator_thread->current_floor != 5)
-                {
-                    elevator_thread->current_floor++;
-                }
-                else
-                {
-                    elevator_thread->current_state = DOWN;
-                    elevator_thread->current_floor--;
-                    elevator_thread->direction = 0;
-                }
-            }
-            else
-            {
-                elevator_thread->current_state = IDLE;
-            }
+            show_slo(m, row - 1);
         }
+    }
+    else if (row == 0)
+    {
+        seq_printf(m, "%s%s\n%-11s %10s %14s %14s %14s %14s %14s\n", metric ? "\n" : "",
+                   headings[metric], "", "count", "mean", "p50", "p90", "p99", "max");
+    }
+    else if (row <= NUM_TYPES)
+    {
+        snprintf(label, sizeof(label), "type %c", "PLBV"[row - 1]);
+        show_histogram(m, label, &type_stats[row - 1][metric]);
+    }
+    else
+    {
+        snprintf(label, sizeof(label), "floor %d", row - NUM_TYPES);
+        show_histogram(m, label, &floor_stats[(row - NUM_TYPES - 1) * NUM_METRICS + metric]);
+    }
 
-        mutex_unlock(&elevator_thread->elevator_mutex);
-        mutex_unlock(&floors.floors_mutex);
-        break;
+    return 0;
+}
 
-    case DOWN:
-        ssleep(2);
+static const struct seq_operations stats_seq_ops = {
+    .start = stats_seq_start,
+    .next = stats_seq_next,
+    .stop = stats_seq_stop,
+    .show = stats_seq_show,
+};
 
-        mutex_lock_interruptible(&elevator_thread->elevator_mutex);
-        mutex_lock_interruptible(&floors.floors_mutex);
-        if ((can_load_passenger(elevator_thread) && !elevator_thread->deactivating) ||
-            can_unload_passenger(elevator_thread))
-        {
-            elevator_thread->current_state = LOADING;
-        }
-        else
-        {
-            if ((floors.num_passengers_waiting > 0 && !elevator_thread->deactivating) || elevator_thread->num_passengers > 0)
-            {
-                if (elevator_thread->current_floor != 1)
-                {
-                    elevator_thread->current_floor--;
-                }
-                else
-                {
-                    elevator_thread->current_state = UP;
-                    elevator_thread->current_floor++;
-                    elevator_thread->direction = 1;
-                }
-            }
-            else
-            {
-                elevator_thread->current_state = IDLE;
-            }
-        }
+static int stats_open(struct inode *inode, struct file *file)
+{
+    return seq_open(file, &stats_seq_ops);
+}
 
-        mutex_unlock(&elevator_thread->elevator_mutex);
-        mutex_unlock(&floors.floors_mutex);
-        break;
+static ssize_t stats_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos)
+{
+    reset_trip_stats();
+    return count;
+}
 
-    default:
-        ssleep(1);
-        break;
-    }
+// /proc/elevator_parking has a summary record, one per car with its last
+// parking decision, then one per floor from the top down with its rate for
+// every hour of the day. Nothing in it takes a lock.
+static void *parking_seq_start(struct seq_file *m, loff_t *pos)
+{
+    // record n is returned as n + 1, NULL ends the sequence
+    return *pos < 1 + num_cars + num_floors ? (void *)(uintptr_t)(*pos + 1) : NULL;
 }
 
-/*===========================================================================*/
-/*============================Proc File Function=============================*/
-/*===========================================================================*/
+static void *parking_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    ++*pos;
+    return parking_seq_start(m, pos);
+}
 
-static ssize_t elevator_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+static void parking_seq_stop(struct seq_file *m, void *v)
 {
-    mutex_lock_interruptible(&elevator.elevator_mutex);
-    mutex_lock_interruptible(&floors.floors_mutex);
+}
 
-    char buf[10000];
-    int len = 0;
-    struct Passenger *passenger;
-    struct Passenger *elevator_temp;
+static void show_parking_car(struct seq_file *m, struct Elevator *car)
+{
+    struct ParkingDecision parked = car->parked;
 
-    switch (elevator.current_state)
+    if (!parked.to)
     {
-    case OFFLINE:
-        len = sprintf(buf, "Elevator state: %s\n", "OFFLINE");
-        break;
-    case IDLE:
-        len = sprintf(buf, "Elevator state: %s\n", "IDLE");
-        break;
-    case LOADING:
-        len = sprintf(buf, "Elevator state: %s\n", "LOADING");
-        break;
-    case UP:
-        len = sprintf(buf, "Elevator state: %s\n", "UP");
-        break;
-    case DOWN:
-        len = sprintf(buf, "Elevator state: %s\n", "DOWN");
-        break;
+        seq_printf(m, "Elevator %d: no parking decision yet\n", car->id + 1);
+        return;
     }
 
-    len += sprintf(buf + len, "Current floor: %d\n", elevator.current_floor);
-    len += sprintf(buf + len, "Current load: %d\n", elevator.weight);
-    len += sprintf(buf + len, "Elevator status: ");
+    seq_printf(m, "Elevator %d: floor %d -> %d%s, next caller %u.%02u -> %u.%02u floors away\n",
+               car->id + 1, parked.from, parked.to, READ_ONCE(car->park_floor) ? " (on the way)" : "",
+               parked.cost_from / 100, parked.cost_from % 100, parked.cost_to / 100,
+               parked.cost_to % 100);
+}
+
+static void show_parking_floor(struct seq_file *m, int floor)
+{
+    unsigned long learned = READ_ONCE(parking_learned);
+    u32 rate;
 
-    if (elevator.initialized)
+    if (floor == num_floors)
     {
-        list_for_each_entry(elevator_temp, &elevator.elevator_list, list)
+        seq_puts(m, "\nArrivals per hour, by hour of the day (UTC)\nFloor");
+        for (int i = 0; i < PARKING_BUCKETS; ++i)
         {
-            len += sprintf(buf + len, "%c%d ", elevator_temp->type,
-                           elevator_temp->destination_floor);
+            seq_printf(m, "     %02d", i);
         }
+        seq_puts(m, "\n");
     }
 
-    len += sprintf(buf + len, "\n\n");
-
-    for (int floor_counter = 4; floor_counter >= 0; floor_counter--)
+    seq_printf(m, "%5d", floor);
+    for (int i = 0; i < PARKING_BUCKETS; ++i)
     {
-        if (elevator.current_floor == floor_counter + 1)
-        {
-            len += sprintf(buf + len, "[*] Floor %d: %d", floor_counter + 1,
-                           floors.curr_waiting[floor_counter]);
-        }
-        else
-        {
-            len += sprintf(buf + len, "[ ] Floor %d: %d", floor_counter + 1,
-                           floors.curr_waiting[floor_counter]);
-        }
-        if (floors.initialized)
+        if (!test_bit(i, &learned))
         {
-            list_for_each_entry(passenger, &floors.floor_lists[floor_counter], list)
-            {
-                len += sprintf(buf + len, " %c%d", passenger->type,
-                               passenger->destination_floor);
-            }
+            seq_puts(m, "      -");
+            continue;
         }
-
-        len += sprintf(buf + len, "\n");
+        rate = READ_ONCE(parking_rates[i * num_floors + floor - 1]);
+        seq_printf(m, " %4u.%u", rate / RATE_SCALE, rate % RATE_SCALE);
     }
+    seq_puts(m, "\n");
+}
 
-    len += sprintf(buf + len, "\nNumber of passengers: %d\n",
-                   elevator.num_passengers);
-    len += sprintf(buf + len, "Number of passengers waiting: %d\n",
-                   floors.num_passengers_waiting);
-    len += sprintf(buf + len, "Number of passengers serviced: %d\n",
-                   elevator.num_serviced);
-    // you can finish the rest.
+static int parking_seq_show(struct seq_file *m, void *v)
+{
+    int record = (uintptr_t)v - 1;
+    int bucket = -1;
 
-    mutex_unlock(&elevator.elevator_mutex);
-    mutex_unlock(&floors.floors_mutex);
+    if (record == 0)
+    {
+        parking_rates_now(&bucket);
+        seq_printf(m, "Parking: %s, hour %02llu", READ_ONCE(parking) ? "on" : "off",
+                   (u64)ktime_get_real_seconds() / PARKING_WINDOW_S % PARKING_BUCKETS);
+        if (bucket >= 0)
+        {
+            seq_printf(m, " (parking by the rates for %02d)", bucket);
+        }
+        seq_printf(m, "\nDecisions: %lld (%lld moved, %lld floors travelled)\n\n",
+                   atomic64_read(&parking_decisions), atomic64_read(&parking_moves),
+                   atomic64_read(&parking_floors));
+    }
+    else if (record <= num_cars)
+    {
+        show_parking_car(m, &elevators[record - 1]);
+    }
+    else
+    {
+        show_parking_floor(m, num_floors - (record - num_cars - 1));
+    }
 
-    return simple_read_from_buffer(ubuf, count, ppos, buf, len); // better than copy_from_user
+    return 0;
 }
 
 /*===========================================================================*/
 /*=============================Cleanup Functions=============================*/
 /*===========================================================================*/
 
-void clean_up(struct Elevator *elevator_thread, struct Floors *floors)
+void clean_up(struct Elevator *cars, int count, struct Floors *floors)
 {
     struct Passenger *ele_pass1, *ele_pass2;
     struct Passenger *floor_pass1, *floor_pass2;
+    struct Elevator *elevator_thread;
+    struct llist_node *pending;
 
-    mutex_lock_interruptible(&elevator_thread->elevator_mutex);
-    if (elevator_thread->num_passengers > 0)
+    for (int car = 0; car < count; ++car)
     {
-        if (!list_empty(&elevator_thread->elevator_list))
+        elevator_thread = &cars[car];
+
+        mutex_lock(&elevator_thread->elevator_mutex);
+        if (elevator_thread->num_passengers > 0)
         {
-            list_for_each_entry_safe(ele_pass1, ele_pass2, &elevator_thread->elevator_list, list)
+            if (!list_empty(&elevator_thread->elevator_list))
             {
-                // Remove the element from the list before freeing it
-                list_del(&ele_pass1->list);
+                list_for_each_entry_safe(ele_pass1, ele_pass2, &elevator_thread->elevator_list, list)
+                {
+                    // Remove the element from the list before freeing it
+                    list_del(&ele_pass1->list);
 
-                // Free the memory associated with the element
-                kfree(ele_pass1);
+                    // Free the memory associated with the element
+                    free_passenger(ele_pass1);
+                }
             }
+            elevator_thread->num_passengers = 0;
         }
-        elevator_thread->num_passengers = 0;
-    }
 
-    mutex_unlock(&elevator_thread->elevator_mutex);
+        mutex_unlock(&elevator_thread->elevator_mutex);
+    }
 
-    mutex_lock_interruptible(&floors->floors_mutex);
     if (floors->initialized)
     {
-        for (int i = 0; i < 5; ++i)
+        for (int i = 0; i < num_floors; ++i)
         {
+            mutex_lock(&floors->floor_locks[i]);
             if (!list_empty(&floors->floor_lists[i]))
             {
                 list_for_each_entry_safe(floor_pass1, floor_pass2, &floors->floor_lists[i], list)
                 {
                     // Remove the element from the list before freeing it
                     list_del(&floor_pass1->list);
+                    list_del(&floor_pass1->queue);
 
                     // Free the memory associated with the element
-                    kfree(floor_pass1);
+                    free_passenger(floor_pass1);
                 }
             }
+            // pushed by a submitter that raced with unloading
+            pending = llist_del_all(&floors->ingest[i]);
+            while (pending)
+            {
+                floor_pass1 = llist_entry(pending, struct Passenger, ingest);
+                pending = pending->next;
+                free_passenger(floor_pass1);
+            }
+            mutex_unlock(&floors->floor_locks[i]);
         }
         floors->initialized = 0;
     }
 }
 
+// Stops every car where it is. A step already running may arm its timer
+// again before it sees elevators_unloading, and that timer may fire after
+// cancel_work_sync(), hence the second cancel. Whatever it or a late kick
+// queued returns at once in elevator_work(), and the flush waits for that,
+// so no step is running or pending once this returns.
+static void stop_cars(void)
+{
+    WRITE_ONCE(elevators_unloading, true);
+    for (int i = 0; i < num_cars; ++i)
+    {
+        hrtimer_cancel(&elevators[i].timer);
+        cancel_work_sync(&elevators[i].work);
+        hrtimer_cancel(&elevators[i].timer);
+    }
+    flush_workqueue(elevator_wq);
+}
+
+// Frees the workqueue, then the per-floor and per-car arrays, the trip
+// histograms and the passenger cache, safe on a partial allocation.
+// destroy_workqueue() drains the queue, so no step is left to find the
+// cars freed.
+static void free_building(void)
+{
+    if (elevator_wq)
+    {
+        destroy_workqueue(elevator_wq);
+    }
+
+    if (elevators)
+    {
+        for (int i = 0; i < num_cars; ++i)
+        {
+            kfree(elevators[i].hall_calls);
+            kfree(elevators[i].car_calls);
+            bitmap_free(elevators[i].hall_map);
+            bitmap_free(elevators[i].car_map);
+            kfree(elevators[i].hall_queues);
+            kfree(elevators[i].hall_stops);
+            kfree(elevators[i].park_cover);
+            // the proc file is gone, nobody can be reading it
+            kfree(rcu_dereference_protected(elevators[i].snapshot, 1));
+        }
+    }
+
+    if (floors.snapshots)
+    {
+        for (int i = 0; i < num_floors; ++i)
+        {
+            kfree(rcu_dereference_protected(floors.snapshots[i], 1));
+        }
+    }
+
+    kfree(elevators);
+    kfree(floors.curr_waiting);
+    kfree(floors.next_seq);
+    kfree(floors.floor_lists);
+    kfree(floors.floor_locks);
+    kfree(floors.ingest);
+    kfree(floors.snapshots);
+    bitmap_free(floors.stale_map);
+    kvfree(floor_stats);
+    kvfree(event_ring);
+    kfree(parking_arrivals);
+    kfree(parking_rates);
+    mempool_destroy(passenger_pool);
+    kmem_cache_destroy(passenger_cache);
+    elevators = NULL;
+    passenger_pool = NULL;
+    passenger_cache = NULL;
+    floors.curr_waiting = NULL;
+    floors.next_seq = NULL;
+    floors.floor_lists = NULL;
+    floors.floor_locks = NULL;
+    floors.ingest = NULL;
+    floors.snapshots = NULL;
+    floors.stale_map = NULL;
+    floor_stats = NULL;
+    event_ring = NULL;
+    parking_arrivals = NULL;
+    parking_rates = NULL;
+    elevator_wq = NULL;
+}
+
 /*===========================================================================*/
 /*=============================Module Functions==============================*/
 /*===========================================================================*/
 
-static const struct proc_ops elevator_fops = {
-    .proc_read = elevator_read,
+static const struct proc_ops stats_fops = {
+    .proc_open = stats_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
+    .proc_write = stats_write,
+};
+
+static const struct proc_ops events_fops = {
+    .proc_open = events_open,
+    .proc_read = events_read,
+    .proc_poll = events_poll,
+    .proc_release = events_release,
+};
+
+static const struct file_operations ring_fops = {
+    .owner = THIS_MODULE,
+    .open = ring_open,
+    .release = ring_release,
+    .mmap = ring_mmap,
+    .unlocked_ioctl = ring_ioctl,
+};
+
+static struct miscdevice ring_device = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = DEVICE_NAME,
+    .fops = &ring_fops,
+    // root and the group udev gives the device, each open pins a ring
+    .mode = 0660,
+};
+
+static const struct seq_operations elevator_seq_ops = {
+    .start = elevator_seq_start,
+    .next = elevator_seq_next,
+    .stop = elevator_seq_stop,
+    .show = elevator_seq_show,
+};
+
+static const struct seq_operations parking_seq_ops = {
+    .start = parking_seq_start,
+    .next = parking_seq_next,
+    .stop = parking_seq_stop,
+    .show = parking_seq_show,
 };
 
 static int __init elevator_init(void)
 {
-    STUB_start_elevator = start_elevator;
-    STUB_issue_request = issue_request;
-    STUB_stop_elevator = stop_elevator;
+    struct Elevator *car;
+    int ret;
 
-    elevator_entry = proc_create(ENTRY_NAME, PERMS, PARENT, &elevator_fops);
-    if (!elevator_entry)
+    if (num_cars < 1 || num_floors < 2 || num_floors > MAX_FLOORS || passenger_reserve < 0 ||
+        !is_power_of_2(ring_entries) || ring_entries > RING_ENTRIES_MAX ||
+        !is_power_of_2(event_entries) || event_entries > EVENT_ENTRIES_MAX)
+    {
+        return -EINVAL;
+    }
+
+    passenger_cache = kmem_cache_create("elevator_passenger", sizeof(struct Passenger), 0,
+                                        SLAB_HWCACHE_ALIGN, NULL);
+    if (!passenger_cache)
+    {
+        return -ENOMEM;
+    }
+
+    if (passenger_reserve > 0)
+    {
+        passenger_pool = mempool_create_slab_pool(passenger_reserve, passenger_cache);
+        if (!passenger_pool)
+        {
+            free_building();
+            return -ENOMEM;
+        }
+    }
+
+    elevator_wq = alloc_workqueue("elevator", WQ_UNBOUND, 0);
+    if (!elevator_wq)
     {
+        free_building();
         return -ENOMEM;
     }
+    elevators_unloading = false;
+
+    // per-floor state is sized by num_floors at load time
+    elevators = kcalloc(num_cars, sizeof(struct Elevator), GFP_KERNEL);
+    floors.curr_waiting = kcalloc(num_floors, sizeof(int), GFP_KERNEL);
+    floors.next_seq = kcalloc(num_floors, sizeof(u64), GFP_KERNEL);
+    floors.floor_lists = kcalloc(num_floors, sizeof(struct list_head), GFP_KERNEL);
+    floors.floor_locks = kcalloc(num_floors, sizeof(struct mutex), GFP_KERNEL);
+    floors.ingest = kcalloc(num_floors, sizeof(struct llist_head), GFP_KERNEL);
+    floors.snapshots = kcalloc(num_floors, sizeof(struct FloorSnapshot *), GFP_KERNEL);
+    floors.stale_map = bitmap_zalloc(num_floors, GFP_KERNEL);
+    floor_stats = kvcalloc(num_floors * NUM_METRICS, sizeof(struct Histogram), GFP_KERNEL);
+    event_ring = kvcalloc(event_entries, sizeof(struct elevator_event), GFP_KERNEL);
+    parking_arrivals = kcalloc(num_floors, sizeof(atomic_t), GFP_KERNEL);
+    parking_rates = kcalloc(PARKING_BUCKETS * num_floors, sizeof(u32), GFP_KERNEL);
+    if (!elevators || !floors.curr_waiting || !floors.next_seq || !floors.floor_lists ||
+        !floors.floor_locks || !floors.ingest || !floors.snapshots || !floors.stale_map || !floor_stats || !event_ring ||
+        !parking_arrivals || !parking_rates)
+    {
+        free_building();
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        car = &elevators[i];
+        car->hall_calls = kcalloc(num_floors, sizeof(int), GFP_KERNEL);
+        car->car_calls = kcalloc(num_floors, sizeof(int), GFP_KERNEL);
+        car->hall_map = bitmap_zalloc(num_floors, GFP_KERNEL);
+        car->car_map = bitmap_zalloc(num_floors, GFP_KERNEL);
+        car->hall_queues = kcalloc(num_floors * NUM_TYPES, sizeof(struct list_head), GFP_KERNEL);
+        car->hall_stops = kcalloc(num_floors, sizeof(int), GFP_KERNEL);
+        car->park_cover = kcalloc(num_floors, sizeof(u32), GFP_KERNEL);
+        if (!car->hall_calls || !car->car_calls || !car->hall_map || !car->car_map ||
+            !car->hall_queues || !car->hall_stops || !car->park_cover)
+        {
+            free_building();
+            return -ENOMEM;
+        }
+
+        for (int j = 0; j < num_floors * NUM_TYPES; ++j)
+        {
+            INIT_LIST_HEAD(&car->hall_queues[j]);
+        }
+    }
 
-    mutex_init(&floors.floors_mutex);
+    // one lock class for every floor, none is ever taken inside another
+    for (int i = 0; i < num_floors; ++i)
+    {
+        mutex_init(&floors.floor_locks[i]);
+        init_llist_head(&floors.ingest[i]);
+    }
     initialize_floors(&floors);
+    // nothing is learned until the first window closes
+    parking_learned = 0;
+    parking_window = ktime_get_real_seconds() / PARKING_WINDOW_S;
 
     // elevator initialization
-    elevator.current_floor = 1;
-    elevator.direction = 1;
-    elevator.initialized = 0;
-    elevator.num_serviced = 0;
+    for (int i = 0; i < num_cars; ++i)
+    {
+        mutex_init(&elevators[i].elevator_mutex);
+        hrtimer_init(&elevators[i].timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        elevators[i].timer.function = elevator_timer;
+        INIT_WORK(&elevators[i].work, elevator_work);
+        INIT_LIST_HEAD(&elevators[i].elevator_list);
+        elevators[i].id = i;
+        elevators[i].current_state = OFFLINE;
+        elevators[i].current_floor = 1;
+        elevators[i].direction = 1;
+        elevators[i].initialized = 0;
+        elevators[i].num_serviced = 0;
+    }
+
+    // readers find a snapshot of everything before the first step
+    ret = 0;
+    for (int i = 0; i < num_cars && !ret; ++i)
+    {
+        mutex_lock(&elevators[i].elevator_mutex);
+        ret = publish_car(&elevators[i]);
+        mutex_unlock(&elevators[i].elevator_mutex);
+    }
+    for (int i = 1; i <= num_floors && !ret; ++i)
+    {
+        mutex_lock(floor_lock(i));
+        ret = publish_floor(i);
+        mutex_unlock(floor_lock(i));
+    }
+    if (ret)
+    {
+        free_building();
+        return ret;
+    }
+
+    reset_trip_stats();
+
+    elevator_entry = proc_create_seq(ENTRY_NAME, PERMS, PARENT, &elevator_seq_ops);
+    if (!elevator_entry)
+    {
+        free_building();
+        return -ENOMEM;
+    }
+
+    stats_entry = proc_create(STATS_ENTRY_NAME, PERMS, PARENT, &stats_fops);
+    if (!stats_entry)
+    {
+        proc_remove(elevator_entry);
+        free_building();
+        return -ENOMEM;
+    }
+
+    events_closing = false;
+    events_entry = proc_create(EVENTS_ENTRY_NAME, 0444, PARENT, &events_fops);
+    if (!events_entry)
+    {
+        proc_remove(stats_entry);
+        proc_remove(elevator_entry);
+        free_building();
+        return -ENOMEM;
+    }
+
+    parking_entry = proc_create_seq(PARKING_ENTRY_NAME, 0444, PARENT, &parking_seq_ops);
+    if (!parking_entry)
+    {
+        proc_remove(events_entry);
+        proc_remove(stats_entry);
+        proc_remove(elevator_entry);
+        free_building();
+        return -ENOMEM;
+    }
+
+    ret = misc_register(&ring_device);
+    if (ret)
+    {
+        proc_remove(parking_entry);
+        proc_remove(events_entry);
+        proc_remove(stats_entry);
+        proc_remove(elevator_entry);
+        free_building();
+        return ret;
+    }
+
+    STUB_start_elevator = start_elevator;
+    STUB_issue_request = issue_request;
+    STUB_stop_elevator = stop_elevator;
+    STUB_issue_requests = issue_requests;
 
     return 0;
 }
@@ -678,16 +3696,34 @@ static void __exit elevator_exit(void)
     STUB_start_elevator = NULL;
     STUB_issue_request = NULL;
     STUB_stop_elevator = NULL;
+    STUB_issue_requests = NULL;
+    proc_remove(elevator_entry);
+    proc_remove(stats_entry);
+    // proc_remove() waits for reads in progress, so end the blocked ones
+    WRITE_ONCE(events_closing, true);
+    wake_up_all(&events_wait);
+    proc_remove(events_entry);
+    proc_remove(parking_entry);
+    // no file is open, the device holds a module reference while one is
+    misc_deregister(&ring_device);
+
+    // no car steps after this
+    stop_cars();
+
+    // Memory cleanup
+    clean_up(elevators, num_cars, &floors);
 
     // Mutex cleanup
-    mutex_unlock(&elevator.elevator_mutex);
-    mutex_unlock(&floors.floors_mutex);
-    mutex_destroy(&elevator.elevator_mutex);
-    mutex_destroy(&floors.floors_mutex);
+    for (int i = 0; i < num_cars; ++i)
+    {
+        mutex_destroy(&elevators[i].elevator_mutex);
+    }
+    for (int i = 0; i < num_floors; ++i)
+    {
+        mutex_destroy(&floors.floor_locks[i]);
+    }
 
-    // Memory cleanup
-    clean_up(&elevator, &floors);
-    proc_remove(elevator_entry);
+    free_building();
 }
 
 module_init(elevator_init);
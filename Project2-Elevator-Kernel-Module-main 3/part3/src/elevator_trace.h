@@ -0,0 +1,136 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM elevator
+
+#if !defined(_ELEVATOR_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ELEVATOR_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// same values as enum elevator_state
+#define show_elevator_state(state)                                        \
+    __print_symbolic(state, {0, "OFFLINE"}, {1, "IDLE"}, {2, "LOADING"}, \
+                     {3, "UP"}, {4, "DOWN"})
+
+TRACE_EVENT(elevator_state,
+
+            TP_PROTO(int car, int old_state, int new_state, int floor, int load, int passengers,
+                     int waiting),
+
+            TP_ARGS(car, old_state, new_state, floor, load, passengers, waiting),
+
+            TP_STRUCT__entry(
+                __field(int, car)
+                __field(int, old_state)
+                __field(int, new_state)
+                __field(int, floor)
+                __field(int, load)
+                __field(int, passengers)
+                __field(int, waiting)),
+
+            TP_fast_assign(
+                __entry->car = car;
+                __entry->old_state = old_state;
+                __entry->new_state = new_state;
+                __entry->floor = floor;
+                __entry->load = load;
+                __entry->passengers = passengers;
+                __entry->waiting = waiting;),
+
+            TP_printk("car=%d %s->%s floor=%d load=%d passengers=%d waiting=%d",
+                      __entry->car, show_elevator_state(__entry->old_state),
+                      show_elevator_state(__entry->new_state), __entry->floor, __entry->load,
+                      __entry->passengers, __entry->waiting));
+
+TRACE_EVENT(passenger_enqueue,
+
+            TP_PROTO(int car, char type, int start_floor, int destination_floor, int floor_waiting,
+                     int waiting),
+
+            TP_ARGS(car, type, start_floor, destination_floor, floor_waiting, waiting),
+
+            TP_STRUCT__entry(
+                __field(int, car)
+                __field(char, type)
+                __field(int, start_floor)
+                __field(int, destination_floor)
+                __field(int, floor_waiting)
+                __field(int, waiting)),
+
+            TP_fast_assign(
+                __entry->car = car;
+                __entry->type = type;
+                __entry->start_floor = start_floor;
+                __entry->destination_floor = destination_floor;
+                __entry->floor_waiting = floor_waiting;
+                __entry->waiting = waiting;),
+
+            TP_printk("car=%d type=%c from=%d to=%d floor_waiting=%d waiting=%d",
+                      __entry->car, __entry->type, __entry->start_floor,
+                      __entry->destination_floor, __entry->floor_waiting, __entry->waiting));
+
+TRACE_EVENT(passenger_board,
+
+            TP_PROTO(int car, char type, int floor, int destination_floor, int load, int passengers,
+                     int floor_waiting, s64 wait_us),
+
+            TP_ARGS(car, type, floor, destination_floor, load, passengers, floor_waiting, wait_us),
+
+            TP_STRUCT__entry(
+                __field(int, car)
+                __field(char, type)
+                __field(int, floor)
+                __field(int, destination_floor)
+                __field(int, load)
+                __field(int, passengers)
+                __field(int, floor_waiting)
+                __field(s64, wait_us)),
+
+            TP_fast_assign(
+                __entry->car = car;
+                __entry->type = type;
+                __entry->floor = floor;
+                __entry->destination_floor = destination_floor;
+                __entry->load = load;
+                __entry->passengers = passengers;
+                __entry->floor_waiting = floor_waiting;
+                __entry->wait_us = wait_us;),
+
+            TP_printk("car=%d type=%c floor=%d to=%d load=%d passengers=%d floor_waiting=%d wait_us=%lld",
+                      __entry->car, __entry->type, __entry->floor, __entry->destination_floor,
+                      __entry->load, __entry->passengers, __entry->floor_waiting,
+                      __entry->wait_us));
+
+TRACE_EVENT(passenger_alight,
+
+            TP_PROTO(int car, char type, int floor, int load, int passengers, s64 trip_us),
+
+            TP_ARGS(car, type, floor, load, passengers, trip_us),
+
+            TP_STRUCT__entry(
+                __field(int, car)
+                __field(char, type)
+                __field(int, floor)
+                __field(int, load)
+                __field(int, passengers)
+                __field(s64, trip_us)),
+
+            TP_fast_assign(
+                __entry->car = car;
+                __entry->type = type;
+                __entry->floor = floor;
+                __entry->load = load;
+                __entry->passengers = passengers;
+                __entry->trip_us = trip_us;),
+
+            TP_printk("car=%d type=%c floor=%d load=%d passengers=%d trip_us=%lld",
+                      __entry->car, __entry->type, __entry->floor, __entry->load,
+                      __entry->passengers, __entry->trip_us));
+
+#endif
+
+// the header lives next to elevator.c instead of in include/trace/events
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE elevator_trace
+#include <trace/define_trace.h>
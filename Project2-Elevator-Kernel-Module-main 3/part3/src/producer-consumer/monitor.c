@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include "wrappers.h"
+
+static const char *state_names[] = { "OFFLINE", "IDLE", "LOADING", "UP", "DOWN" };
+
+static volatile sig_atomic_t stop;
+
+void on_signal(int sig) {
+	stop = 1;
+}
+
+void print_event(struct elevator_event *event) {
+	printf("%llu.%06llu #%u car %u ", event->timestamp_ns / 1000000000ULL,
+	       event->timestamp_ns % 1000000000ULL / 1000, event->seq, event->car);
+
+	switch (event->type) {
+	case ELEVATOR_EVENT_STATE:
+		printf("%s at floor %u", event->value < 5 ? state_names[event->value] : "?", event->floor);
+		break;
+	case ELEVATOR_EVENT_ENQUEUE:
+		printf("passenger %llu waits at floor %u for %u", event->id, event->floor, event->value);
+		break;
+	case ELEVATOR_EVENT_BOARD:
+		printf("passenger %llu boards at floor %u for %u", event->id, event->floor, event->value);
+		break;
+	case ELEVATOR_EVENT_ALIGHT:
+		printf("passenger %llu alights at floor %u", event->id, event->floor);
+		break;
+	default:
+		printf("event type %u", event->type);
+	}
+	printf(" (%u on board, %u waiting)\n", event->passengers, event->waiting);
+}
+
+void usage() {
+	printf("usage: monitor [-q] [-n events]\n");
+}
+
+int main(int argc, char **argv) {
+	struct elevator_event events[256];
+	struct epoll_event ready;
+	unsigned long long read_events = 0, lost = 0, gaps = 0, limit = 0;
+	unsigned int expected = 0;
+	int quiet = 0;
+	int first = 1;
+	int fd, epfd, opt, i;
+	ssize_t len;
+
+	while ((opt = getopt(argc, argv, "qn:h")) != -1) {
+		switch (opt) {
+		case 'q':
+			quiet = 1;
+			break;
+		case 'n':
+			limit = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+
+	fd = open(ELEVATOR_EVENTS, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(ELEVATOR_EVENTS);
+		return -1;
+	}
+	epfd = epoll_create1(0);
+	ready.events = EPOLLIN;
+	ready.data.fd = fd;
+	if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ready) != 0) {
+		perror("epoll");
+		return -1;
+	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	// sleeps in epoll_wait() until the elevator does something
+	while (!stop && (!limit || read_events < limit)) {
+		if (epoll_wait(epfd, &ready, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			break;
+		}
+
+		while ((len = read(fd, events, sizeof(events))) > 0) {
+			for (i = 0; i < len / (ssize_t)sizeof(struct elevator_event); i++) {
+				if (!first && events[i].seq != expected)
+					gaps++;
+				first = 0;
+				if (events[i].type == ELEVATOR_EVENT_OVERRUN) {
+					printf("lost %llu events\n", events[i].id);
+					lost += events[i].id;
+					expected = events[i].seq + events[i].id;
+					continue;
+				}
+				expected = events[i].seq + 1;
+				read_events++;
+				if (!quiet)
+					print_event(&events[i]);
+			}
+		}
+		// 0 means the module is going away
+		if (len == 0)
+			break;
+		fflush(stdout);
+	}
+
+	printf("%llu events read, %llu lost, %llu gaps\n", read_events, lost, gaps);
+	close(epfd);
+	close(fd);
+	return 0;
+}
@@ -1,36 +1,419 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include "wrappers.h"
 
+// Arrival patterns, as fractions of the requests that start or end on the
+// lobby (floor 1). day runs up, lunch and down over successive thirds.
+enum pattern { UNIFORM, UP_PEAK, DOWN_PEAK, LUNCH, DAY };
+
+static const char *pattern_names[] = { "uniform", "up", "down", "lunch", "day" };
+
+struct arrival {
+	double time;
+	int start;
+	int dest;
+	int type;
+};
+
 int rnd(int min, int max) {
 	return rand() % (max - min + 1) + min; //slight bias towards first k
 }
 
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// sleeps until begin + offset seconds on the monotonic clock, so pacing
+// errors do not add up over a run. Returns -1 if the clock cannot be slept on.
+int sleep_until(double begin, double offset) {
+	struct timespec ts;
+	double when = begin + offset;
+	int err;
+
+	ts.tv_sec = (time_t)when;
+	ts.tv_nsec = (long)((when - ts.tv_sec) * 1e9);
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR)
+		;
+	if (err) {
+		errno = err;
+		perror("clock_nanosleep");
+		return -1;
+	}
+	return 0;
+}
+
+double rnd_unit() {
+	return (rand() + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+void lobby_trip(int lobby_start, int floors, int *start, int *dest) {
+	int other = rnd(2, floors);
+
+	*start = lobby_start ? 1 : other;
+	*dest = lobby_start ? other : 1;
+}
+
+// picks the floors of the i-th of num arrivals
+void pick_floors(enum pattern pattern, int i, int num, int floors, int *start, int *dest) {
+	double pick = rnd_unit();
+
+	if (pattern == DAY)
+		pattern = i < num / 3 ? UP_PEAK : i < 2 * num / 3 ? LUNCH : DOWN_PEAK;
+
+	if (pattern == UP_PEAK && pick < 0.85) {
+		lobby_trip(1, floors, start, dest);
+		return;
+	}
+	if (pattern == DOWN_PEAK && pick < 0.85) {
+		lobby_trip(0, floors, start, dest);
+		return;
+	}
+	if (pattern == LUNCH && pick < 0.90) {
+		lobby_trip(pick < 0.45, floors, start, dest);
+		return;
+	}
+
+	*start = rnd(1, floors);
+	do {
+		*dest = rnd(1, floors);
+	} while(*dest == *start);
+}
+
+// Reads "seconds start dest type" lines, # starts a comment. Returns the
+// number of arrivals, or -1 on a malformed or out of order line or when
+// there are none.
+int read_trace(const char *path, struct arrival **arrivals) {
+	FILE *file = fopen(path, "r");
+	struct arrival *list = NULL, *grown;
+	char line[256];
+	int count = 0, size = 0, lineno = 0;
+
+	if (!file) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		lineno++;
+		line[strcspn(line, "#\n")] = '\0';
+		if (line[strspn(line, " \t\r")] == '\0')
+			continue;
+
+		if (count == size) {
+			size = size ? size * 2 : 1024;
+			grown = realloc(list, sizeof(struct arrival) * size);
+			if (!grown) {
+				printf("out of memory\n");
+				free(list);
+				fclose(file);
+				return -1;
+			}
+			list = grown;
+		}
+		if (sscanf(line, "%lf %d %d %d", &list[count].time, &list[count].start,
+			   &list[count].dest, &list[count].type) != 4 ||
+		    (count > 0 && list[count].time < list[count - 1].time)) {
+			printf("%s:%d: expected nondecreasing \"seconds start dest type\"\n", path, lineno);
+			free(list);
+			fclose(file);
+			return -1;
+		}
+		count++;
+	}
+
+	fclose(file);
+	if (count == 0) {
+		printf("%s: no arrivals\n", path);
+		return -1;
+	}
+	*arrivals = list;
+	return count;
+}
+
+// num Poisson arrivals at rate per second, or back to back when rate is 0
+struct arrival *generate(enum pattern pattern, int num, double rate, int floors) {
+	struct arrival *list = malloc(sizeof(struct arrival) * (num > 0 ? num : 1));
+	double time = 0;
+	int i;
+
+	if (!list)
+		return NULL;
+
+	for (i = 0; i < num; i++) {
+		if (rate > 0)
+			time += -log(rnd_unit()) / rate;
+		list[i].time = time;
+		list[i].type = rnd(0, 3);
+		pick_floors(pattern, i, num, floors, &list[i].start, &list[i].dest);
+	}
+	return list;
+}
+
+int compare_double(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+double percentile(double *sorted, int count, double p) {
+	int i = (int)ceil(p * count) - 1;
+
+	return sorted[i < 0 ? 0 : i];
+}
+
+// counts the completions the kernel has posted so far
+void reap_ring(struct elevator_ring *ring, int *completed, int *accepted) {
+	struct elevator_cqe cqe;
+
+	while (elevator_ring_reap(ring, &cqe)) {
+		(*completed)++;
+		if (cqe.status == 0)
+			(*accepted)++;
+	}
+}
+
+void usage() {
+	printf("usage: producer [-u] [-r rate] [-p uniform|up|down|lunch|day] [-t trace] [-o trace_out]\n"
+	       "                [-f floors] [-s seed] [num_of_requests] [batch_size]\n");
+}
+
 int main(int argc, char **argv) {
-	int type;
-	int start;
-	int dest;
 	int i;
-	int num;
-	srand(time(0));
+	int num = -1;
+	int batch = 1;
+	int floors = 5;
+	int pending = 0;
+	int accepted = 0;
+	int calls = 0;
+	int completed = 0;
+	int doorbells = 0;
+	int use_ring = 0;
+	int paced;
+	int opt;
+	long ret;
+	unsigned int seed = time(0);
+	double rate = 0;
+	double begin, start, elapsed = 0, span, lag, lag_sum = 0, lag_max = 0;
+	enum pattern pattern = UNIFORM;
+	const char *trace = NULL;
+	const char *trace_out = NULL;
+	struct elevator_request *requests;
+	struct arrival *arrivals;
+	double *latencies;
+	int *statuses;
+	struct elevator_ring ring;
+	FILE *out;
 
-	if (argc != 2) {
-		printf("wrong number of args. producer.x num_of_requests\n");
+	while ((opt = getopt(argc, argv, "ur:p:t:o:f:s:h")) != -1) {
+		switch (opt) {
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'p':
+			for (i = 0; i <= DAY && strcmp(optarg, pattern_names[i]) != 0; i++)
+				;
+			if (i > DAY) {
+				usage();
+				return -1;
+			}
+			pattern = i;
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		case 'o':
+			trace_out = optarg;
+			break;
+		case 'f':
+			floors = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			use_ring = 1;
+			break;
+		default:
+			usage();
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+
+	if (optind < argc)
+		sscanf(argv[optind++], "%d", &num);
+	if (optind < argc)
+		sscanf(argv[optind++], "%d", &batch);
+	if (optind < argc || (num < 0 && !trace)) {
+		printf("wrong number of args. producer.x num_of_requests [batch_size]\n");
+		usage();
+		return -1;
+	}
+	if (batch < 1) {
+		printf("batch_size must be at least 1\n");
+		return -1;
+	}
+	if (floors < 2 || rate < 0) {
+		usage();
 		return -1;
 	}
-	sscanf(argv[1],"%d",&num);
+	srand(seed);
+
+	if (trace) {
+		// the trace sets the schedule, num only caps it
+		i = read_trace(trace, &arrivals);
+		if (i < 0)
+			return -1;
+		if (num < 0 || num > i)
+			num = i;
+	} else {
+		arrivals = generate(pattern, num, rate, floors);
+	}
+	paced = trace || rate > 0;
+
+	requests = malloc(sizeof(struct elevator_request) * batch);
+	statuses = malloc(sizeof(int) * batch);
+	latencies = malloc(sizeof(double) * (num > 0 ? num : 1));
+	if (!requests || !statuses || !latencies || !arrivals) {
+		printf("out of memory\n");
+		return -1;
+	}
+
+	if (use_ring && elevator_ring_open(&ring) != 0) {
+		perror(ELEVATOR_DEVICE);
+		return -1;
+	}
+
+	begin = now();
 	for(i=0; i < num;i+=1)
 	{
-		type = rnd(0,3);
+		// a batch goes out when its last request is due
+		if (paced && (batch == 1 || pending == batch - 1 || i == num - 1)) {
+			if (sleep_until(begin, arrivals[i].time) != 0)
+				return -1;
+			lag = now() - begin - arrivals[i].time;
+			lag_sum += lag;
+			if (lag > lag_max)
+				lag_max = lag;
+		}
 
-		start = rnd(1, 5);
-		do {
-			dest = rnd(1, 5);
-		} while(dest == start);
+		// a batch here is how many requests go out per flush
+		if (use_ring) {
+			while (elevator_ring_submit(&ring, arrivals[i].start, arrivals[i].dest,
+						    arrivals[i].type, i) != 0) {
+				// full: hand over what is there and make room
+				if (elevator_ring_flush(&ring) > 0)
+					doorbells++;
+				reap_ring(&ring, &completed, &accepted);
+				usleep(100);
+			}
+			if (++pending == batch || i == num - 1) {
+				start = now();
+				ret = elevator_ring_flush(&ring);
+				latencies[calls] = now() - start;
+				elapsed += latencies[calls++];
+				if (ret < 0) {
+					perror("doorbell");
+					return -1;
+				}
+				doorbells += ret;
+				pending = 0;
+			}
+			reap_ring(&ring, &completed, &accepted);
+			continue;
+		}
 
-		long ret = issue_request(start, dest, type);
-		printf("Issue (%d, %d, %d) returned %ld\n", start, dest, type, ret);
+		if (batch == 1) {
+			start = now();
+			ret = issue_request(arrivals[i].start, arrivals[i].dest, arrivals[i].type);
+			latencies[calls] = now() - start;
+			elapsed += latencies[calls++];
+			if (ret == 0)
+				accepted++;
+			// printing would throw off the pacing
+			if (!paced)
+				printf("Issue (%d, %d, %d) returned %ld\n", arrivals[i].start,
+				       arrivals[i].dest, arrivals[i].type, ret);
+			continue;
+		}
+
+		requests[pending].start_floor = arrivals[i].start;
+		requests[pending].destination_floor = arrivals[i].dest;
+		requests[pending].type = arrivals[i].type;
+		if (++pending == batch || i == num - 1) {
+			start = now();
+			ret = issue_requests(requests, statuses, pending);
+			latencies[calls] = now() - start;
+			elapsed += latencies[calls++];
+			if (ret < 0) {
+				printf("Issue batch of %d returned %ld\n", pending, ret);
+				return -1;
+			}
+			accepted += ret;
+			pending = 0;
+		}
 	}
+	span = now() - begin;
+
+	// a busy car takes requests at its next step, which can be a while
+	if (use_ring) {
+		while (completed < num) {
+			if (elevator_ring_flush(&ring) > 0)
+				doorbells++;
+			reap_ring(&ring, &completed, &accepted);
+			if (completed < num)
+				usleep(1000);
+		}
+		elevator_ring_close(&ring);
+	}
+
+	// time spent inside the syscalls only
+	printf("Issued %d of %d requests in %.6f s (%.0f requests/s, batch size %d)\n",
+		accepted, num, elapsed, elapsed > 0 ? num / elapsed : 0.0, batch);
+
+	if (paced && num > 0) {
+		// the schedule ends at the last arrival, the run when it was issued
+		printf("Rate: %.2f requests/s requested, %.2f achieved over %.3f s\n",
+		       !trace ? rate : arrivals[num - 1].time > 0 ? num / arrivals[num - 1].time : 0.0,
+		       span > 0 ? num / span : 0.0, span);
+		printf("Pacing lag: mean %.1f us, max %.1f us\n",
+		       lag_sum / calls * 1e6, lag_max * 1e6);
+	}
+
+	if (use_ring)
+		printf("Ring: %d flushes, %d rang the doorbell\n", calls, doorbells);
+
+	if (calls > 0) {
+		qsort(latencies, calls, sizeof(double), compare_double);
+		printf("%s latency: mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us (%d calls)\n",
+		       use_ring ? "Flush" : "Syscall",
+		       elapsed / calls * 1e6, percentile(latencies, calls, 0.50) * 1e6,
+		       percentile(latencies, calls, 0.99) * 1e6, latencies[calls - 1] * 1e6, calls);
+	}
+
+	// the requests as issued, replayable with -t
+	if (trace_out) {
+		out = fopen(trace_out, "w");
+		if (!out) {
+			perror(trace_out);
+			return -1;
+		}
+		fprintf(out, "# seconds start dest type\n");
+		for (i = 0; i < num; i++)
+			fprintf(out, "%.6f %d %d %d\n", arrivals[i].time, arrivals[i].start,
+				arrivals[i].dest, arrivals[i].type);
+		fclose(out);
+	}
+
+	free(requests);
+	free(statuses);
+	free(latencies);
+	free(arrivals);
 	return 0;
 }
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "wrappers.h"
+
+// Every thread makes the same number of issue_request() calls, either valid
+// ones that queue a passenger or invalid ones (start floor 0) that are
+// rejected before anything is allocated or locked.
+enum mode { VALID, INVALID };
+
+static const char *mode_names[] = { "valid", "invalid" };
+
+struct worker {
+	pthread_t thread;
+	int cpu;
+	enum mode mode;
+	long calls;
+	unsigned int seed;
+	unsigned long long *latencies;
+	long accepted;
+	unsigned long long begin;
+	unsigned long long end;
+};
+
+static pthread_barrier_t start_barrier;
+static int floors = 5;
+
+unsigned long long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void *worker_thread(void *data) {
+	struct worker *worker = data;
+	cpu_set_t cpus;
+	unsigned long long begin;
+	int start, dest;
+	long i;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(worker->cpu, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+	pthread_barrier_wait(&start_barrier);
+
+	worker->begin = now_ns();
+	for (i = 0; i < worker->calls; i++) {
+		start = rand_r(&worker->seed) % floors + 1;
+		dest = rand_r(&worker->seed) % (floors - 1) + 1;
+		if (dest >= start)
+			dest++;
+		if (worker->mode == INVALID)
+			start = 0;
+
+		begin = now_ns();
+		if (issue_request(start, dest, rand_r(&worker->seed) % 4) == 0)
+			worker->accepted++;
+		worker->latencies[i] = now_ns() - begin;
+	}
+	worker->end = now_ns();
+
+	return NULL;
+}
+
+int compare_u64(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+unsigned long long percentile(unsigned long long *sorted, long count, double p) {
+	long i = (long)ceil(p * count) - 1;
+
+	return sorted[i < 0 ? 0 : i];
+}
+
+// one row of the table: threads threads, calls calls each
+int run(enum mode mode, int threads, long calls, int cpus, const char *label, FILE *csv) {
+	struct worker *workers = calloc(threads, sizeof(struct worker));
+	unsigned long long *latencies = malloc(sizeof(unsigned long long) * threads * calls);
+	unsigned long long begin = ~0ULL, end = 0;
+	long total = threads * calls, accepted = 0;
+	double sum = 0, throughput;
+	int i;
+
+	if (!workers || !latencies) {
+		printf("out of memory\n");
+		return -1;
+	}
+
+	pthread_barrier_init(&start_barrier, NULL, threads + 1);
+	for (i = 0; i < threads; i++) {
+		workers[i].cpu = i % cpus;
+		workers[i].mode = mode;
+		workers[i].calls = calls;
+		workers[i].seed = i + 1;
+		workers[i].latencies = latencies + i * calls;
+		pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]);
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	// from the first call made to the last one returning, as the main
+	// thread may not run again before the workers are done
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		accepted += workers[i].accepted;
+		if (workers[i].begin < begin)
+			begin = workers[i].begin;
+		if (workers[i].end > end)
+			end = workers[i].end;
+	}
+	pthread_barrier_destroy(&start_barrier);
+
+	qsort(latencies, total, sizeof(unsigned long long), compare_u64);
+	for (i = 0; i < total; i++)
+		sum += latencies[i];
+	throughput = total / ((end - begin) / 1e9);
+
+	printf("%-8s %7d %14.0f %10.0f %10llu %10llu %10llu %12llu %9ld\n", mode_names[mode], threads,
+	       throughput, sum / total, percentile(latencies, total, 0.50),
+	       percentile(latencies, total, 0.99), percentile(latencies, total, 0.999),
+	       latencies[total - 1], accepted);
+	fflush(stdout);
+
+	if (csv)
+		fprintf(csv, "%s,%s,%d,%ld,%.0f,%.0f,%llu,%llu,%llu,%llu,%ld\n", label, mode_names[mode],
+			threads, total, throughput, sum / total, percentile(latencies, total, 0.50),
+			percentile(latencies, total, 0.99), percentile(latencies, total, 0.999),
+			latencies[total - 1], accepted);
+
+	free(workers);
+	free(latencies);
+	return 0;
+}
+
+void usage() {
+	printf("usage: syscall_bench [-n calls_per_thread] [-t max_threads] [-m valid|invalid|both]\n"
+	       "                     [-f floors] [-c csv_file] [-l label]\n");
+}
+
+int main(int argc, char **argv) {
+	long calls = 10000;
+	int max_threads = 64;
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int modes = 3;
+	int opt;
+	int threads;
+	const char *label = "run";
+	const char *csv_path = NULL;
+	FILE *csv = NULL;
+
+	while ((opt = getopt(argc, argv, "n:t:m:f:c:l:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			calls = atol(optarg);
+			break;
+		case 't':
+			max_threads = atoi(optarg);
+			break;
+		case 'm':
+			modes = strcmp(optarg, "valid") == 0 ? 1 : strcmp(optarg, "invalid") == 0 ? 2 :
+				strcmp(optarg, "both") == 0 ? 3 : 0;
+			break;
+		case 'f':
+			floors = atoi(optarg);
+			break;
+		case 'c':
+			csv_path = optarg;
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		default:
+			usage();
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+
+	if (calls < 1 || max_threads < 1 || modes == 0 || floors < 2 || cpus < 1) {
+		usage();
+		return -1;
+	}
+
+	// appended to, so runs against different module builds line up
+	if (csv_path) {
+		csv = fopen(csv_path, "a");
+		if (!csv) {
+			perror(csv_path);
+			return -1;
+		}
+		fseek(csv, 0, SEEK_END);
+		if (ftell(csv) == 0)
+			fprintf(csv, "label,mode,threads,calls,calls_per_s,mean_ns,p50_ns,p99_ns,p999_ns,max_ns,accepted\n");
+	}
+
+	printf("%d cpus, %ld calls per thread\n", cpus, calls);
+	printf("%-8s %7s %14s %10s %10s %10s %10s %12s %9s\n", "mode", "threads", "calls/s",
+	       "mean ns", "p50 ns", "p99 ns", "p99.9 ns", "max ns", "accepted");
+
+	for (int mode = VALID; mode <= INVALID; mode++) {
+		if (!(modes & (1 << mode)))
+			continue;
+		for (threads = 1; ; threads *= 2) {
+			if (threads > max_threads)
+				threads = max_threads;
+			if (run(mode, threads, calls, cpus, label, csv) != 0)
+				return -1;
+			if (threads == max_threads)
+				break;
+		}
+	}
+
+	if (csv)
+		fclose(csv);
+	return 0;
+}
@@ -3,11 +3,88 @@
 
 #define _GNU_SOURCE
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 
 #define __NR_START_ELEVATOR 548
 #define __NR_ISSUE_REQUEST 549
 #define __NR_STOP_ELEVATOR 550
+#define __NR_ISSUE_REQUESTS 551
+
+#define ELEVATOR_DEVICE "/dev/elevator"
+#define ELEVATOR_RING_NEED_WAKEUP 1
+#define ELEVATOR_IOC_DOORBELL _IO('E', 0)
+
+#define ELEVATOR_EVENTS "/proc/elevator_events"
+#define ELEVATOR_EVENT_STATE 1
+#define ELEVATOR_EVENT_ENQUEUE 2
+#define ELEVATOR_EVENT_BOARD 3
+#define ELEVATOR_EVENT_ALIGHT 4
+#define ELEVATOR_EVENT_OVERRUN 5
+
+// One entry of an issue_requests() batch, same layout as in elevator.c
+struct elevator_request {
+	int start_floor;
+	int destination_floor;
+	int type;
+};
+
+// Start of a /dev/elevator mapping, same layout as in elevator.c. Userspace
+// owns sq_tail and cq_head, the kernel sq_head and cq_tail.
+struct elevator_ring_header {
+	unsigned int sq_head;
+	unsigned int sq_tail;
+	unsigned int cq_head;
+	unsigned int cq_tail;
+	unsigned int entries;
+	unsigned int flags;
+	unsigned int sq_offset;
+	unsigned int cq_offset;
+};
+
+struct elevator_sqe {
+	int start_floor;
+	int destination_floor;
+	int type;
+	unsigned int user_data;
+};
+
+// status is what issue_request() would have returned, passenger_id is 0
+// for a rejected request
+struct elevator_cqe {
+	unsigned int user_data;
+	int status;
+	unsigned long long passenger_id;
+};
+
+// A mapped /dev/elevator ring. Requests are written at sq_tail and only
+// seen by the kernel once elevator_ring_flush() publishes them.
+struct elevator_ring {
+	int fd;
+	struct elevator_ring_header *header;
+	struct elevator_sqe *sq;
+	struct elevator_cqe *cq;
+	unsigned int entries;
+	unsigned int sq_tail;
+	size_t size;
+};
+
+// One record of /proc/elevator_events, same layout as in elevator.c. value
+// is the new state (0 OFFLINE to 4 DOWN) or the passenger's destination.
+// An ELEVATOR_EVENT_OVERRUN record says id events from seq on were lost.
+struct elevator_event {
+	unsigned long long timestamp_ns;
+	unsigned long long id;
+	unsigned int seq;
+	unsigned short type;
+	unsigned short car;
+	unsigned short floor;
+	unsigned short value;
+	unsigned short passengers;
+	unsigned short waiting;
+};
 
 int start_elevator() {
 	return syscall(__NR_START_ELEVATOR);
@@ -21,4 +98,86 @@ int stop_elevator() {
 	return syscall(__NR_STOP_ELEVATOR);
 }
 
+// Queues count requests at once. statuses[i] is what issue_request() would
+// have returned for requests[i]. Returns the number of requests queued.
+int issue_requests(const struct elevator_request *requests, int *statuses, unsigned int count) {
+	return syscall(__NR_ISSUE_REQUESTS, requests, statuses, count);
+}
+
+// Opens and maps a ring of its own. Returns 0, or -1 with errno set.
+int elevator_ring_open(struct elevator_ring *ring) {
+	long page = sysconf(_SC_PAGESIZE);
+	struct elevator_ring_header *header;
+
+	ring->fd = open(ELEVATOR_DEVICE, O_RDWR);
+	if (ring->fd < 0)
+		return -1;
+
+	// the header tells how big the rest is
+	header = mmap(NULL, page, PROT_READ, MAP_SHARED, ring->fd, 0);
+	if (header == MAP_FAILED) {
+		close(ring->fd);
+		return -1;
+	}
+	ring->entries = header->entries;
+	ring->size = header->cq_offset + ring->entries * sizeof(struct elevator_cqe);
+	munmap(header, page);
+
+	ring->header = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (ring->header == MAP_FAILED) {
+		close(ring->fd);
+		return -1;
+	}
+	ring->sq = (void *)((char *)ring->header + ring->header->sq_offset);
+	ring->cq = (void *)((char *)ring->header + ring->header->cq_offset);
+	ring->sq_tail = ring->header->sq_tail;
+	return 0;
+}
+
+// Queues a request without publishing it. Returns 0, or -1 if the
+// submission ring is full.
+int elevator_ring_submit(struct elevator_ring *ring, int start, int dest, int type, unsigned int user_data) {
+	struct elevator_sqe *sqe;
+
+	if (ring->sq_tail - __atomic_load_n(&ring->header->sq_head, __ATOMIC_ACQUIRE) == ring->entries)
+		return -1;
+
+	sqe = &ring->sq[ring->sq_tail & (ring->entries - 1)];
+	sqe->start_floor = start;
+	sqe->destination_floor = dest;
+	sqe->type = type;
+	sqe->user_data = user_data;
+	ring->sq_tail++;
+	return 0;
+}
+
+// Publishes the queued requests. The cars pick them up while any of them
+// is running, otherwise the doorbell hands them over at once. Returns 1 if
+// it rang the doorbell, 0 if not, -1 on error.
+int elevator_ring_flush(struct elevator_ring *ring) {
+	__atomic_store_n(&ring->header->sq_tail, ring->sq_tail, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!(__atomic_load_n(&ring->header->flags, __ATOMIC_RELAXED) & ELEVATOR_RING_NEED_WAKEUP))
+		return 0;
+	return ioctl(ring->fd, ELEVATOR_IOC_DOORBELL) < 0 ? -1 : 1;
+}
+
+// Takes the oldest completion. Returns 1 if there was one, 0 if not.
+int elevator_ring_reap(struct elevator_ring *ring, struct elevator_cqe *cqe) {
+	unsigned int head = ring->header->cq_head;
+
+	if (head == __atomic_load_n(&ring->header->cq_tail, __ATOMIC_ACQUIRE))
+		return 0;
+
+	*cqe = ring->cq[head & (ring->entries - 1)];
+	__atomic_store_n(&ring->header->cq_head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// Requests not yet taken by the kernel are dropped
+void elevator_ring_close(struct elevator_ring *ring) {
+	munmap(ring->header, ring->size);
+	close(ring->fd);
+}
+
 #endif
@@ -0,0 +1,842 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "kshim.h"
+
+// The module is compiled as-is against the shims in include/linux.
+#include "../elevator.c"
+
+// the producer and the proc reader still run as kthreads
+#include <linux/delay.h>
+#include <linux/kthread.h>
+
+// normally provided by syscalls.c in the kernel tree
+int (*STUB_start_elevator)(void) = NULL;
+int (*STUB_issue_request)(int, int, int) = NULL;
+int (*STUB_stop_elevator)(void) = NULL;
+int (*STUB_issue_requests)(const void __user *, int __user *, unsigned int) = NULL;
+
+// Arrival patterns, as in producer: the share of riders who start or end
+// on the lobby (floor 1). day follows the simulated clock, up in the
+// morning, lunch at midday and down in the evening.
+enum pattern
+{
+    UNIFORM,
+    UP_PEAK,
+    DOWN_PEAK,
+    LUNCH,
+    DAY
+};
+
+static const char *pattern_names[] = {"uniform", "up", "down", "lunch", "day"};
+
+struct bench_config
+{
+    long passengers;
+    double rate_per_hour;
+    int batch;
+    u64 seed;
+    double proc_interval;
+    int dump_proc;
+    int ring;
+    double events_delay;
+    int mix[4];
+    enum pattern pattern;
+};
+
+struct bench_stats
+{
+    long issued;
+    long rejected;
+    long completed;
+    long idle_completed;
+    u64 *waits;
+    u64 *trips;
+    u64 *idle_waits;
+    u64 *pickups;
+    long picked;
+    long doorbells;
+    long events_read;
+    long event_reads;
+    u64 events_lost;
+    long event_gaps;
+    u64 elevator_steps;
+    u64 elevator_cpu_ns;
+    long boardings;
+    long loading_stops;
+    long proc_reads;
+    u64 proc_bytes;
+    u64 proc_cpu_ns;
+    double switch_ns;
+    double event_ns;
+};
+
+static struct bench_config config = {
+    .passengers = 100000,
+    .rate_per_hour = 600.0,
+    .batch = 1,
+    .seed = 1,
+    .events_delay = -1,
+    .mix = {1, 1, 1, 1},
+};
+
+static struct bench_stats stats;
+static struct task_struct *reader;
+static struct task_struct *follower;
+static enum elevator_state *last_state;
+static u64 rng_state;
+
+// -R: /dev/elevator as a producer would map it, driven through the module's
+// own file operations
+static struct file ring_file;
+static struct elevator_ring_header *ring_header;
+static u32 ring_sq_tail;
+static u32 ring_sq_seen;
+static u64 *ring_submit_ns;
+
+/*===========================================================================*/
+/*=============================Random Functions==============================*/
+/*===========================================================================*/
+
+static u64 rng_next(void)
+{
+    // xorshift64*, so every run is reproducible from its seed
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rnd_unit(void)
+{
+    return (rng_next() >> 11) * 0x1.0p-53;
+}
+
+static int rnd(int min, int max)
+{
+    return rng_next() % (max - min + 1) + min;
+}
+
+static void lobby_trip(int lobby_start, int *start, int *dest)
+{
+    int other = rnd(2, num_floors);
+
+    *start = lobby_start ? 1 : other;
+    *dest = lobby_start ? other : 1;
+}
+
+// start and destination floors of the next rider under config.pattern
+static void pick_floors(int *start, int *dest)
+{
+    enum pattern pattern = config.pattern;
+    int hour = sim_clock_ns / NSEC_PER_SEC / 3600 % 24;
+    double pick = rnd_unit();
+
+    if (pattern == DAY)
+    {
+        pattern = hour >= 7 && hour < 10 ? UP_PEAK : hour >= 11 && hour < 14 ? LUNCH :
+                  hour >= 16 && hour < 19 ? DOWN_PEAK : UNIFORM;
+    }
+
+    if (pattern == UP_PEAK && pick < 0.85)
+    {
+        lobby_trip(1, start, dest);
+        return;
+    }
+    if (pattern == DOWN_PEAK && pick < 0.85)
+    {
+        lobby_trip(0, start, dest);
+        return;
+    }
+    if (pattern == LUNCH && pick < 0.90)
+    {
+        lobby_trip(pick < 0.45, start, dest);
+        return;
+    }
+
+    *start = rnd(1, num_floors);
+    do
+    {
+        *dest = rnd(1, num_floors);
+    } while (*dest == *start);
+}
+
+// passenger type drawn with the relative frequencies in config.mix
+static int rnd_type(void)
+{
+    int total = config.mix[0] + config.mix[1] + config.mix[2] + config.mix[3];
+    int pick = rnd(0, total - 1);
+    int type = 0;
+
+    while (pick >= config.mix[type])
+    {
+        pick -= config.mix[type++];
+    }
+    return type;
+}
+
+/*===========================================================================*/
+/*=============================Traffic Functions=============================*/
+/*===========================================================================*/
+
+static int riders_on_board(void)
+{
+    int riders = 0;
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        riders += elevators[i].num_passengers;
+    }
+    return riders;
+}
+
+static void issue_one(int start, int dest, int type)
+{
+    struct Passenger *passenger;
+    struct Elevator *car;
+
+    if (issue_request(start, dest, type) == 0)
+    {
+        // remember riders whose car was idle, their wait is the
+        // elevator's reaction time
+        passenger = list_last_entry(&floors.floor_lists[start - 1], struct Passenger, list);
+        car = &elevators[passenger->car];
+        sim_obj(passenger)->tag = car->current_state == IDLE || car->current_state == OFFLINE;
+        stats.issued++;
+    }
+    else
+    {
+        stats.rejected++;
+    }
+}
+
+static void issue_batch(struct elevator_request *requests, int *statuses, int count)
+{
+    int accepted = issue_requests(requests, statuses, count);
+
+    if (accepted < 0)
+    {
+        stats.rejected += count;
+        return;
+    }
+    stats.issued += accepted;
+    stats.rejected += count - accepted;
+}
+
+static int ring_setup(void)
+{
+    struct vm_area_struct vma = {0};
+    struct Ring *ring;
+
+    if (ring_fops.open(NULL, &ring_file) != 0)
+    {
+        return -1;
+    }
+    ring = ring_file.private_data;
+    vma.vm_end = PAGE_ALIGN(ring->size);
+    if (ring_fops.mmap(&ring_file, &vma) != 0)
+    {
+        ring_fops.release(NULL, &ring_file);
+        return -1;
+    }
+    ring_header = vma.sim_addr;
+    ring_submit_ns = calloc(ring_header->entries, sizeof(u64));
+    return ring_submit_ns ? 0 : -1;
+}
+
+// times how long the requests the kernel just took sat on the ring
+static void ring_taken(void)
+{
+    u32 head = READ_ONCE(ring_header->sq_head);
+
+    for (; ring_sq_seen != head; ++ring_sq_seen)
+    {
+        stats.pickups[stats.picked++] = sim_clock_ns - ring_submit_ns[ring_sq_seen & (ring_header->entries - 1)];
+    }
+}
+
+static void ring_reap(void)
+{
+    struct elevator_cqe *cq = (void *)ring_header + ring_header->cq_offset;
+    u32 head = ring_header->cq_head;
+
+    for (; head != smp_load_acquire(&ring_header->cq_tail); ++head)
+    {
+        if (cq[head & (ring_header->entries - 1)].status == 0)
+        {
+            stats.issued++;
+        }
+        else
+        {
+            stats.rejected++;
+        }
+    }
+    smp_store_release(&ring_header->cq_head, head);
+}
+
+// publishes what was submitted, ringing the doorbell only if no car will
+// pick it up on its own
+static void ring_flush(void)
+{
+    smp_store_release(&ring_header->sq_tail, ring_sq_tail);
+    smp_mb();
+    if (READ_ONCE(ring_header->flags) & ELEVATOR_RING_NEED_WAKEUP)
+    {
+        ring_fops.unlocked_ioctl(&ring_file, ELEVATOR_IOC_DOORBELL, 0);
+        stats.doorbells++;
+        ring_taken();
+    }
+    ring_reap();
+}
+
+static void ring_submit(int start, int dest, int type, u32 user_data)
+{
+    struct elevator_sqe *sq = (void *)ring_header + ring_header->sq_offset;
+    u32 slot;
+
+    // full: wait for a car to make room
+    while (ring_sq_tail - smp_load_acquire(&ring_header->sq_head) == ring_header->entries)
+    {
+        ring_flush();
+        sim_sleep_ns(NSEC_PER_MSEC);
+    }
+
+    slot = ring_sq_tail++ & (ring_header->entries - 1);
+    sq[slot].start_floor = start;
+    sq[slot].destination_floor = dest;
+    sq[slot].type = type;
+    sq[slot].user_data = user_data;
+    ring_submit_ns[slot] = sim_clock_ns;
+}
+
+static int producer_thread(void *data)
+{
+    struct elevator_request *requests = calloc(config.batch, sizeof(struct elevator_request));
+    int *statuses = calloc(config.batch, sizeof(int));
+    double gap_seconds;
+    int type, start, dest;
+    int pending = 0;
+
+    for (long i = 0; i < config.passengers; ++i)
+    {
+        // Poisson arrivals at the configured rate
+        gap_seconds = -log(1.0 - rnd_unit()) * 3600.0 / config.rate_per_hour;
+        sim_sleep_ns((u64)(gap_seconds * NSEC_PER_SEC));
+
+        type = rnd_type();
+        pick_floors(&start, &dest);
+
+        // a batch on the ring is how many requests go out per flush
+        if (config.ring)
+        {
+            ring_submit(start, dest, type, i);
+            if (++pending == config.batch || i == config.passengers - 1)
+            {
+                ring_flush();
+                pending = 0;
+            }
+            continue;
+        }
+
+        if (config.batch == 1)
+        {
+            issue_one(start, dest, type);
+            continue;
+        }
+
+        // batched riders are issued together once the batch fills up
+        requests[pending].start_floor = start;
+        requests[pending].destination_floor = dest;
+        requests[pending].type = type;
+        if (++pending == config.batch || i == config.passengers - 1)
+        {
+            issue_batch(requests, statuses, pending);
+            pending = 0;
+        }
+    }
+    free(requests);
+    free(statuses);
+
+    // a busy car takes the last requests at its next step
+    while (config.ring && stats.issued + stats.rejected < config.passengers)
+    {
+        sim_sleep_ns(NSEC_PER_MSEC);
+        ring_flush();
+    }
+
+    // stopping early would strand everyone still waiting on a floor
+    while (atomic_read(&floors.num_passengers_waiting) > 0 || riders_on_board() > 0)
+    {
+        ssleep(1);
+    }
+    if (config.ring)
+    {
+        ring_fops.release(NULL, &ring_file);
+        ring_header = NULL;
+        free(ring_submit_ns);
+    }
+    stop_elevator();
+    if (reader)
+    {
+        kthread_stop(reader);
+    }
+    if (follower)
+    {
+        kthread_stop(follower);
+    }
+
+    return 0;
+}
+
+// cat /proc/elevator every proc_interval simulated seconds
+static int reader_thread(void *data)
+{
+    size_t len;
+
+    while (!kthread_should_stop())
+    {
+        sim_sleep_ns((u64)(config.proc_interval * NSEC_PER_SEC));
+        if (kthread_should_stop())
+        {
+            break;
+        }
+        free(sim_proc_read(elevator_entry, &len));
+        stats.proc_reads++;
+        stats.proc_bytes += len;
+    }
+
+    return 0;
+}
+
+// Follows /proc/elevator_events like a logger: waits for what poll() would
+// report, then reads everything there is events_delay simulated seconds
+// later, checking that the sequence numbers have no gaps
+static int follower_thread(void *data)
+{
+    struct file file = {.f_flags = O_NONBLOCK};
+    struct elevator_event events[64];
+    struct EventReader *follow;
+    u32 expected = 0;
+    int first = 1;
+    ssize_t len;
+
+    if (events_fops.proc_open(NULL, &file) != 0)
+    {
+        return 0;
+    }
+    follow = file.private_data;
+
+    while (!kthread_should_stop())
+    {
+        wait_event(events_wait, events_ready(follow) || kthread_should_stop());
+        if (config.events_delay > 0)
+        {
+            sim_sleep_ns((u64)(config.events_delay * NSEC_PER_SEC));
+        }
+
+        while ((len = events_fops.proc_read(&file, (char *)events, sizeof(events), NULL)) > 0)
+        {
+            stats.event_reads++;
+            for (size_t i = 0; i < len / sizeof(struct elevator_event); ++i)
+            {
+                if (!first && events[i].seq != expected)
+                {
+                    stats.event_gaps++;
+                }
+                first = 0;
+                if (events[i].type == ELEVATOR_EVENT_OVERRUN)
+                {
+                    stats.events_lost += events[i].id;
+                    expected = events[i].seq + events[i].id;
+                }
+                else
+                {
+                    stats.events_read++;
+                    expected = events[i].seq + 1;
+                }
+            }
+        }
+    }
+
+    events_fops.proc_release(NULL, &file);
+    return 0;
+}
+
+static void bench_step(struct task_struct *task)
+{
+    if (task->threadfn == reader_thread && task->exited)
+    {
+        stats.proc_cpu_ns = task->cpu_ns;
+    }
+}
+
+static void bench_event(struct sim_event *event, u64 cpu_ns)
+{
+    struct work_struct *work;
+    struct Elevator *car;
+    struct Passenger *passenger;
+
+    // only car steps, not the timers that queue them
+    if (event->fn != sim_run_work)
+    {
+        return;
+    }
+    work = container_of(event, struct work_struct, event);
+    if (work->func != elevator_work)
+    {
+        return;
+    }
+    car = container_of(work, struct Elevator, work);
+    stats.elevator_steps++;
+    // the cars keep stepping after the producer releases the ring
+    if (ring_header)
+    {
+        ring_taken();
+    }
+    stats.elevator_cpu_ns += cpu_ns;
+
+    // anyone on board without a mark boarded during this step
+    list_for_each_entry(passenger, &car->elevator_list, list)
+    {
+        if (!sim_obj(passenger)->mark_ns)
+        {
+            sim_obj(passenger)->mark_ns = sim_clock_ns;
+            stats.boardings++;
+        }
+    }
+
+    // the step that just ran started in the state recorded after the last one
+    if (last_state[car->id] == LOADING)
+    {
+        stats.loading_stops++;
+    }
+    last_state[car->id] = car->current_state;
+}
+
+static void bench_free(void *ptr)
+{
+    struct sim_obj *obj = sim_obj(ptr);
+
+    if (!obj->mark_ns)
+    {
+        return;
+    }
+
+    stats.waits[stats.completed] = obj->mark_ns - obj->born_ns;
+    stats.trips[stats.completed] = sim_clock_ns - obj->born_ns;
+    stats.completed++;
+
+    if (obj->tag)
+    {
+        stats.idle_waits[stats.idle_completed++] = obj->mark_ns - obj->born_ns;
+    }
+}
+
+static int null_thread(void *data)
+{
+    for (int i = 0; i < 100000; ++i)
+    {
+        sim_sleep_ns(1);
+    }
+    stats.switch_ns = (double)current->cpu_ns / current->steps;
+    return 0;
+}
+
+static struct work_struct null_work;
+static long null_runs;
+
+static void null_work_fn(struct work_struct *work)
+{
+    if (++null_runs < 100000)
+    {
+        queue_work(NULL, work);
+    }
+}
+
+static void null_event(struct sim_event *event, u64 cpu_ns)
+{
+    stats.event_ns += cpu_ns;
+}
+
+static void calibrate(void)
+{
+    // cost of a step that does nothing but yield, and of a work item that
+    // does nothing but requeue itself, subtracted from the report
+    sim_task_create(null_thread, NULL, "calibrate");
+    INIT_WORK(&null_work, null_work_fn);
+    queue_work(NULL, &null_work);
+    sim_event_hook = null_event;
+    sim_run();
+    stats.event_ns /= null_runs;
+    sim_clock_ns = 0;
+}
+
+/*===========================================================================*/
+/*=============================Report Functions==============================*/
+/*===========================================================================*/
+
+static int compare_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64 *)a;
+    u64 y = *(const u64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void summarize(const char *label, u64 *samples, long count)
+{
+    double sum = 0;
+    long p99;
+
+    if (count == 0)
+    {
+        printf("%-22s n/a\n", label);
+        return;
+    }
+
+    qsort(samples, count, sizeof(u64), compare_u64);
+    for (long i = 0; i < count; ++i)
+    {
+        sum += samples[i];
+    }
+    p99 = (long)ceil(0.99 * count) - 1;
+
+    printf("%-22s mean %.1f s, p99 %.1f s, max %.1f s\n", label,
+           sum / count / NSEC_PER_SEC,
+           (double)samples[p99] / NSEC_PER_SEC,
+           (double)samples[count - 1] / NSEC_PER_SEC);
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-n passengers] [-r arrivals_per_hour] [-b batch] [-s seed] [-m P,L,B,V] [-p proc_interval] [-d] [-t trace_file] [-R] [-e delay] [-P uniform|up|down|lunch|day] [-o param=value]...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    double wall_start, wall_time, sim_hours, cpu_per_step;
+    char *value, *proc;
+    size_t proc_len;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:b:s:m:p:dt:Re:P:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.passengers = atol(optarg);
+            break;
+        case 'r':
+            config.rate_per_hour = atof(optarg);
+            break;
+        case 'b':
+            config.batch = atoi(optarg);
+            break;
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (sscanf(optarg, "%d,%d,%d,%d", &config.mix[0], &config.mix[1], &config.mix[2],
+                       &config.mix[3]) != 4)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            config.proc_interval = atof(optarg);
+            break;
+        case 'd':
+            config.dump_proc = 1;
+            break;
+        case 't':
+            // elevator:* trace events, as the kernel would log them
+            sim_trace_file = fopen(optarg, "w");
+            if (!sim_trace_file)
+            {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            config.ring = 1;
+            break;
+        case 'e':
+            config.events_delay = atof(optarg);
+            break;
+        case 'P':
+            for (opt = UNIFORM; opt <= DAY && strcmp(optarg, pattern_names[opt]) != 0; ++opt)
+            {
+            }
+            if (opt > DAY)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            config.pattern = opt;
+            break;
+        case 'o':
+            // module parameter, as passed to insmod
+            value = strchr(optarg, '=');
+            if (!value)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            *value++ = '\0';
+            if (sim_param_set(optarg, value) != 0)
+            {
+                printf("invalid module parameter %s=%s\n", optarg, value);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (config.passengers < 0 || config.rate_per_hour <= 0 || config.batch < 1 || (!config.ring && config.batch > ISSUE_BATCH_MAX) ||
+        config.proc_interval < 0 || config.mix[0] < 0 || config.mix[1] < 0 || config.mix[2] < 0 ||
+        config.mix[3] < 0 || config.mix[0] + config.mix[1] + config.mix[2] + config.mix[3] == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    rng_state = config.seed ? config.seed : 1;
+    stats.waits = malloc(sizeof(u64) * (config.passengers + 1));
+    stats.trips = malloc(sizeof(u64) * (config.passengers + 1));
+    stats.idle_waits = malloc(sizeof(u64) * (config.passengers + 1));
+    stats.pickups = malloc(sizeof(u64) * (config.passengers + 1));
+    if (!stats.waits || !stats.trips || !stats.idle_waits || !stats.pickups)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    calibrate();
+
+    sim_step_hook = bench_step;
+    sim_event_hook = bench_event;
+    sim_free_hook = bench_free;
+
+    if (elevator_init() != 0)
+    {
+        printf("elevator_init failed\n");
+        return 1;
+    }
+    last_state = calloc(num_cars, sizeof(enum elevator_state));
+    if (config.ring && ring_setup() != 0)
+    {
+        printf("ring setup failed\n");
+        return 1;
+    }
+    start_elevator();
+    sim_task_create(producer_thread, NULL, "producer");
+    if (config.proc_interval > 0)
+    {
+        reader = sim_task_create(reader_thread, NULL, "reader");
+    }
+    if (config.events_delay >= 0)
+    {
+        follower = sim_task_create(follower_thread, NULL, "follower");
+    }
+
+    wall_start = wall_seconds();
+    sim_run();
+    wall_time = wall_seconds() - wall_start;
+
+    sim_free_hook = NULL;
+    sim_hours = (double)sim_clock_ns / NSEC_PER_SEC / 3600.0;
+
+    printf("cars:                  %d\n", num_cars);
+    printf("passengers issued:     %ld (%ld rejected)\n", stats.issued, stats.rejected);
+    printf("passengers serviced:   %ld\n", stats.completed);
+    printf("simulated time:        %.2f h\n", sim_hours);
+    printf("throughput:            %.1f passengers/h\n",
+           sim_hours > 0 ? stats.completed / sim_hours : 0.0);
+    summarize("wait (issue->board):", stats.waits, stats.completed);
+    summarize("trip (issue->alight):", stats.trips, stats.completed);
+    summarize("wait on an idle car:", stats.idle_waits, stats.idle_completed);
+    printf("trip target misses:   ");
+    for (int i = 0; i < NUM_TYPES; ++i)
+    {
+        long trips = atomic64_read(&type_stats[i][TRIP_TIME].count);
+
+        printf(" %c %lld (%.1f%%)", "PLBV"[i], atomic64_read(&slo_misses[i]),
+               trips ? 100.0 * atomic64_read(&slo_misses[i]) / trips : 0.0);
+    }
+    printf("\n");
+    if (config.ring)
+    {
+        // waits above start when a car takes the request off the ring
+        summarize("ring pickup:", stats.pickups, stats.picked);
+        printf("ring doorbells:        %ld\n", stats.doorbells);
+    }
+    printf("boardings per stop:    %.2f (%ld loading stops, %.2f per rider serviced)\n",
+           stats.loading_stops ? (double)stats.boardings / stats.loading_stops : 0.0, stats.loading_stops,
+           stats.completed ? (double)stats.loading_stops / stats.completed : 0.0);
+    printf("elevator steps:        %llu\n", (unsigned long long)stats.elevator_steps);
+    cpu_per_step = stats.elevator_steps ? (double)stats.elevator_cpu_ns / stats.elevator_steps : 0.0;
+    printf("cpu per step:          %.0f ns (%.0f ns net of %.0f ns scheduler overhead)\n",
+           cpu_per_step, max(cpu_per_step - stats.event_ns, 0.0), stats.event_ns);
+    printf("passenger allocations: %lld (%lld ns average)\n",
+           atomic64_read(&passenger_allocs),
+           atomic64_read(&passenger_allocs) ?
+               atomic64_read(&passenger_alloc_ns) / atomic64_read(&passenger_allocs) : 0);
+    if (stats.proc_reads)
+    {
+        printf("proc reads:            %ld (%llu bytes, %.0f ns average)\n", stats.proc_reads,
+               (unsigned long long)(stats.proc_bytes / stats.proc_reads),
+               max((double)stats.proc_cpu_ns / stats.proc_reads - stats.switch_ns, 0.0));
+    }
+    if (follower)
+    {
+        printf("event stream:          %ld events in %ld reads (%llu lost, %ld gaps)\n",
+               stats.events_read, stats.event_reads, (unsigned long long)stats.events_lost,
+               stats.event_gaps);
+    }
+    if (sim_lockdep_reports)
+    {
+        printf("lockdep reports:       %d (see stderr)\n", sim_lockdep_reports);
+    }
+    printf("wall time:             %.2f s\n", wall_time);
+
+    if (config.dump_proc)
+    {
+        proc = sim_proc_read(elevator_entry, &proc_len);
+        printf("\n%s", proc);
+        free(proc);
+        proc = sim_proc_read(stats_entry, &proc_len);
+        printf("\n%s", proc);
+        free(proc);
+        proc = sim_proc_read(parking_entry, &proc_len);
+        printf("\n%s", proc);
+        free(proc);
+    }
+
+    elevator_exit();
+    free(stats.waits);
+    free(stats.trips);
+    free(stats.idle_waits);
+    free(stats.pickups);
+    free(last_state);
+    if (sim_trace_file)
+    {
+        fclose(sim_trace_file);
+    }
+
+    return 0;
+}
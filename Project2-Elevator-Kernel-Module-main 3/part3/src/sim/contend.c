@@ -0,0 +1,345 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "kshim.h"
+
+// The module is compiled as-is against the shims in include/linux.
+#include "../elevator.c"
+
+// normally provided by syscalls.c in the kernel tree
+int (*STUB_start_elevator)(void) = NULL;
+int (*STUB_issue_request)(int, int, int) = NULL;
+int (*STUB_stop_elevator)(void) = NULL;
+int (*STUB_issue_requests)(const void __user *, int __user *, unsigned int) = NULL;
+
+struct contend_config
+{
+    long requests;
+    int max_threads;
+    int readers;
+    int read_interval_us;
+    u64 seed;
+};
+
+struct producer
+{
+    pthread_t thread;
+    int (*issue)(int start_floor, int destination_floor, int type);
+    long count;
+    u64 rng_state;
+    u64 *latencies;
+};
+
+static struct contend_config config = {
+    .requests = 200000,
+    .max_threads = 64,
+    .readers = 0,
+    .read_interval_us = 1000,
+    .seed = 1,
+};
+
+static pthread_barrier_t start_barrier;
+static int producers_done;
+static long elevator_steps;
+static long proc_reads;
+// stands in for the single floors_mutex the building had before it was
+// split per floor
+static DEFINE_MUTEX(building_mutex);
+static int building_locked;
+
+/*===========================================================================*/
+/*============================Producer Functions=============================*/
+/*===========================================================================*/
+
+static u64 now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static u64 rng_next(u64 *state)
+{
+    // xorshift64*, one stream per producer
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// issue_request() serialized on one building-wide lock, which the cars
+// also take for every step, as with a single floors_mutex
+static int issue_locked(int start_floor, int destination_floor, int type)
+{
+    int ret;
+
+    mutex_lock(&building_mutex);
+    ret = issue_request(start_floor, destination_floor, type);
+    mutex_unlock(&building_mutex);
+
+    return ret;
+}
+
+static void *producer_thread(void *data)
+{
+    struct producer *producer = data;
+    int start, dest;
+    u64 begin;
+
+    pthread_barrier_wait(&start_barrier);
+
+    for (long i = 0; i < producer->count; ++i)
+    {
+        start = rng_next(&producer->rng_state) % num_floors + 1;
+        dest = rng_next(&producer->rng_state) % (num_floors - 1) + 1;
+        if (dest >= start)
+        {
+            dest++;
+        }
+
+        begin = now_ns();
+        producer->issue(start, dest, rng_next(&producer->rng_state) % 4);
+        producer->latencies[i] = now_ns() - begin;
+    }
+
+    return NULL;
+}
+
+/*===========================================================================*/
+/*============================Elevator Functions=============================*/
+/*===========================================================================*/
+
+// Steps every car back to back on one real thread without waiting for its
+// timer, so the cars take the floor locks as often as they can. Each step
+// ends like elevator_work(), by publishing the snapshots.
+static void *elevator_thread(void *data)
+{
+    struct Elevator *car;
+    int busy;
+
+    pthread_barrier_wait(&start_barrier);
+
+    while (!__atomic_load_n(&producers_done, __ATOMIC_ACQUIRE))
+    {
+        busy = 0;
+        for (int i = 0; i < num_cars; ++i)
+        {
+            car = &elevators[i];
+            if (car->current_state != IDLE || atomic_read(&car->num_assigned) > 0)
+            {
+                if (building_locked)
+                {
+                    mutex_lock(&building_mutex);
+                }
+                move_elevator(car);
+                publish_snapshots(car);
+                elevator_steps++;
+                if (building_locked)
+                {
+                    mutex_unlock(&building_mutex);
+                }
+                busy = 1;
+            }
+        }
+        if (!busy)
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+// cat /proc/elevator every read_interval_us until the producers are done,
+// like a monitoring agent
+static void *reader_thread(void *data)
+{
+    size_t len;
+
+    pthread_barrier_wait(&start_barrier);
+
+    while (!__atomic_load_n(&producers_done, __ATOMIC_ACQUIRE))
+    {
+        free(sim_proc_read(elevator_entry, &len));
+        __atomic_add_fetch(&proc_reads, 1, __ATOMIC_RELAXED);
+        if (config.read_interval_us > 0)
+        {
+            usleep(config.read_interval_us);
+        }
+    }
+
+    return NULL;
+}
+
+/*===========================================================================*/
+/*=============================Report Functions==============================*/
+/*===========================================================================*/
+
+static int compare_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64 *)a;
+    u64 y = *(const u64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static u64 percentile(u64 *samples, long count, double p)
+{
+    return samples[(long)ceil(p * count) - 1];
+}
+
+static int run(const char *mode, int (*issue)(int, int, int), int threads)
+{
+    struct producer *producers = calloc(threads, sizeof(struct producer));
+    pthread_t *readers = calloc(config.readers + 1, sizeof(pthread_t));
+    pthread_t elevator;
+    u64 *latencies = malloc(sizeof(u64) * config.requests);
+    u64 begin, elapsed;
+    long offset = 0;
+    double sum = 0;
+
+    if (!producers || !readers || !latencies || elevator_init() != 0)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    // the cars start IDLE, with nothing running their work items
+    for (int i = 0; i < num_cars; ++i)
+    {
+        initialize_elevator(&elevators[i]);
+    }
+
+    producers_done = 0;
+    elevator_steps = 0;
+    proc_reads = 0;
+    building_locked = issue == issue_locked;
+    pthread_barrier_init(&start_barrier, NULL, threads + config.readers + 2);
+    pthread_create(&elevator, NULL, elevator_thread, NULL);
+    for (int i = 0; i < config.readers; ++i)
+    {
+        pthread_create(&readers[i], NULL, reader_thread, NULL);
+    }
+    for (int i = 0; i < threads; ++i)
+    {
+        producers[i].issue = issue;
+        producers[i].count = config.requests / threads + (i < config.requests % threads);
+        producers[i].rng_state = (config.seed + i) * 0x9E3779B97F4A7C15ULL | 1;
+        producers[i].latencies = latencies + offset;
+        offset += producers[i].count;
+        pthread_create(&producers[i].thread, NULL, producer_thread, &producers[i]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    begin = now_ns();
+    for (int i = 0; i < threads; ++i)
+    {
+        pthread_join(producers[i].thread, NULL);
+    }
+    elapsed = now_ns() - begin;
+
+    __atomic_store_n(&producers_done, 1, __ATOMIC_RELEASE);
+    pthread_join(elevator, NULL);
+    for (int i = 0; i < config.readers; ++i)
+    {
+        pthread_join(readers[i], NULL);
+    }
+    pthread_barrier_destroy(&start_barrier);
+    elevator_exit();
+
+    qsort(latencies, config.requests, sizeof(u64), compare_u64);
+    for (long i = 0; i < config.requests; ++i)
+    {
+        sum += latencies[i];
+    }
+
+    printf("%-7s %7d %14.0f %10.0f %10llu %10llu %12llu %12.0f %10.0f\n", mode, threads,
+           config.requests / ((double)elapsed / NSEC_PER_SEC),
+           sum / config.requests,
+           percentile(latencies, config.requests, 0.50),
+           percentile(latencies, config.requests, 0.99),
+           latencies[config.requests - 1],
+           elevator_steps / ((double)elapsed / NSEC_PER_SEC),
+           proc_reads / ((double)elapsed / NSEC_PER_SEC));
+    fflush(stdout);
+
+    free(producers);
+    free(readers);
+    free(latencies);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-n requests] [-t max_threads] [-r readers] [-i read_interval_us] [-s seed] [-o param=value]...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    char *value;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:r:i:s:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.requests = atol(optarg);
+            break;
+        case 't':
+            config.max_threads = atoi(optarg);
+            break;
+        case 'r':
+            config.readers = atoi(optarg);
+            break;
+        case 'i':
+            config.read_interval_us = atoi(optarg);
+            break;
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'o':
+            // module parameter, as passed to insmod
+            value = strchr(optarg, '=');
+            if (!value)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            *value++ = '\0';
+            if (sim_param_set(optarg, value) != 0)
+            {
+                printf("invalid module parameter %s=%s\n", optarg, value);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (config.requests < 1 || config.max_threads < 1 || config.requests < config.max_threads ||
+        config.readers < 0 || config.read_interval_us < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-7s %7s %14s %10s %10s %10s %12s %12s %10s\n", "mode", "threads", "requests/s",
+           "mean ns", "p50 ns", "p99 ns", "max ns", "steps/s", "reads/s");
+    for (int threads = 1; threads <= config.max_threads; threads *= 2)
+    {
+        if (run("global", issue_locked, threads) || run("floor", issue_request, threads))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
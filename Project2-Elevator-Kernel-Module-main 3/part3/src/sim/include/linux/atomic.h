@@ -0,0 +1,75 @@
+#ifndef __SIM_LINUX_ATOMIC_H
+#define __SIM_LINUX_ATOMIC_H
+
+#include <linux/types.h>
+
+typedef struct
+{
+    s64 counter;
+} atomic64_t;
+
+typedef struct
+{
+    int counter;
+} atomic_t;
+
+#define ATOMIC64_INIT(i) { (i) }
+#define ATOMIC_INIT(i) { (i) }
+
+static inline s64 atomic64_read(const atomic64_t *v)
+{
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_set(atomic64_t *v, s64 i)
+{
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_add(s64 i, atomic64_t *v)
+{
+    __atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_inc(atomic64_t *v)
+{
+    atomic64_add(1, v);
+}
+
+static inline s64 atomic64_inc_return(atomic64_t *v)
+{
+    return __atomic_add_fetch(&v->counter, 1, __ATOMIC_RELAXED);
+}
+
+static inline s64 atomic64_cmpxchg(atomic64_t *v, s64 old, s64 new)
+{
+    __atomic_compare_exchange_n(&v->counter, &old, new, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return old;
+}
+
+static inline int atomic_read(const atomic_t *v)
+{
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_set(atomic_t *v, int i)
+{
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_inc(atomic_t *v)
+{
+    __atomic_fetch_add(&v->counter, 1, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_dec(atomic_t *v)
+{
+    __atomic_fetch_sub(&v->counter, 1, __ATOMIC_RELAXED);
+}
+
+static inline int atomic_xchg(atomic_t *v, int i)
+{
+    return __atomic_exchange_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+#endif
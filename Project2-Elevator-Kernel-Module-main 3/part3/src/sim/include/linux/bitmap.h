@@ -0,0 +1,110 @@
+#ifndef __SIM_LINUX_BITMAP_H
+#define __SIM_LINUX_BITMAP_H
+
+#include <linux/slab.h>
+#include <linux/types.h>
+
+#define BITS_PER_LONG (8 * sizeof(unsigned long))
+#define BITS_TO_LONGS(nr) (((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+static inline unsigned long *bitmap_zalloc(unsigned int nbits, int flags)
+{
+    return kcalloc(BITS_TO_LONGS(nbits), sizeof(unsigned long), flags);
+}
+
+static inline void bitmap_free(const unsigned long *bitmap)
+{
+    kfree(bitmap);
+}
+
+static inline void __set_bit(unsigned long nr, unsigned long *addr)
+{
+    addr[nr / BITS_PER_LONG] |= 1UL << (nr % BITS_PER_LONG);
+}
+
+static inline void __clear_bit(unsigned long nr, unsigned long *addr)
+{
+    addr[nr / BITS_PER_LONG] &= ~(1UL << (nr % BITS_PER_LONG));
+}
+
+static inline void set_bit(unsigned long nr, unsigned long *addr)
+{
+    __atomic_fetch_or(&addr[nr / BITS_PER_LONG], 1UL << (nr % BITS_PER_LONG), __ATOMIC_RELAXED);
+}
+
+static inline void clear_bit(unsigned long nr, unsigned long *addr)
+{
+    __atomic_fetch_and(&addr[nr / BITS_PER_LONG], ~(1UL << (nr % BITS_PER_LONG)), __ATOMIC_RELAXED);
+}
+
+static inline bool test_and_clear_bit(unsigned long nr, unsigned long *addr)
+{
+    unsigned long mask = 1UL << (nr % BITS_PER_LONG);
+
+    return __atomic_fetch_and(&addr[nr / BITS_PER_LONG], ~mask, __ATOMIC_ACQ_REL) & mask;
+}
+
+static inline bool test_bit(unsigned long nr, const unsigned long *addr)
+{
+    return (addr[nr / BITS_PER_LONG] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+// first set bit at or after offset, size if there is none
+static inline unsigned long find_next_bit(const unsigned long *addr, unsigned long size,
+                                          unsigned long offset)
+{
+    unsigned long word;
+
+    if (offset >= size)
+    {
+        return size;
+    }
+
+    word = addr[offset / BITS_PER_LONG] & (~0UL << (offset % BITS_PER_LONG));
+    offset -= offset % BITS_PER_LONG;
+    while (!word)
+    {
+        offset += BITS_PER_LONG;
+        if (offset >= size)
+        {
+            return size;
+        }
+        word = addr[offset / BITS_PER_LONG];
+    }
+
+    offset += __builtin_ctzl(word);
+    return offset < size ? offset : size;
+}
+
+// last set bit below size, size if there is none
+static inline unsigned long find_last_bit(const unsigned long *addr, unsigned long size)
+{
+    unsigned long idx, word;
+
+    if (!size)
+    {
+        return 0;
+    }
+
+    idx = (size - 1) / BITS_PER_LONG;
+    word = addr[idx];
+    if ((size % BITS_PER_LONG) != 0)
+    {
+        word &= ~0UL >> (BITS_PER_LONG - size % BITS_PER_LONG);
+    }
+
+    for (;;)
+    {
+        if (word)
+        {
+            return idx * BITS_PER_LONG + BITS_PER_LONG - 1 - __builtin_clzl(word);
+        }
+        if (idx-- == 0)
+        {
+            return size;
+        }
+        word = addr[idx];
+    }
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef __SIM_LINUX_BITOPS_H
+#define __SIM_LINUX_BITOPS_H
+
+#include <linux/types.h>
+
+// last set bit, counting from 1, or 0 if none
+static inline int fls64(u64 x)
+{
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __SIM_LINUX_DELAY_H
+#define __SIM_LINUX_DELAY_H
+
+#include <linux/types.h>
+
+// every sleep yields to the scheduler and advances the virtual clock
+static inline void ssleep(unsigned int seconds)
+{
+    sim_sleep_ns((u64)seconds * NSEC_PER_SEC);
+}
+
+static inline void msleep(unsigned int msecs)
+{
+    sim_sleep_ns((u64)msecs * NSEC_PER_MSEC);
+}
+
+// the timer fires at the start of the range, there is nothing to coalesce
+static inline void usleep_range(unsigned long min, unsigned long max)
+{
+    sim_sleep_ns((u64)min * NSEC_PER_USEC);
+}
+
+#endif
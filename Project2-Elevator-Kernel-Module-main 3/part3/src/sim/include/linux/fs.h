@@ -0,0 +1,32 @@
+#ifndef __SIM_LINUX_FS_H
+#define __SIM_LINUX_FS_H
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+
+struct inode;
+struct vm_area_struct;
+struct module;
+
+struct file
+{
+    unsigned int f_flags;
+    void *private_data;
+};
+
+struct file_operations
+{
+    struct module *owner;
+    int (*open)(struct inode *inode, struct file *file);
+    int (*release)(struct inode *inode, struct file *file);
+    int (*mmap)(struct file *file, struct vm_area_struct *vma);
+    long (*unlocked_ioctl)(struct file *file, unsigned int cmd, unsigned long arg);
+};
+
+static inline int stream_open(struct inode *inode, struct file *file)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __SIM_LINUX_HRTIMER_H
+#define __SIM_LINUX_HRTIMER_H
+
+#include <time.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+
+// An armed timer is an event on the virtual clock. It fires exactly when
+// it expires, the slack only matters to the kernel.
+enum hrtimer_mode
+{
+    HRTIMER_MODE_ABS,
+    HRTIMER_MODE_REL,
+};
+
+enum hrtimer_restart
+{
+    HRTIMER_NORESTART,
+    HRTIMER_RESTART,
+};
+
+struct hrtimer
+{
+    struct sim_event event;
+    enum hrtimer_restart (*function)(struct hrtimer *timer);
+};
+
+static inline void sim_fire_hrtimer(struct sim_event *event)
+{
+    struct hrtimer *timer = container_of(event, struct hrtimer, event);
+
+    timer->function(timer);
+}
+
+static inline void hrtimer_init(struct hrtimer *timer, clockid_t clock_id, enum hrtimer_mode mode)
+{
+    timer->event.fn = sim_fire_hrtimer;
+    timer->event.queued = 0;
+    timer->function = NULL;
+}
+
+static inline void hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim, u64 delta_ns,
+                                          enum hrtimer_mode mode)
+{
+    sim_event_add(&timer->event, mode == HRTIMER_MODE_REL ? sim_clock_ns + tim : tim, 1);
+}
+
+static inline int hrtimer_cancel(struct hrtimer *timer)
+{
+    return sim_event_del(&timer->event);
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef __SIM_LINUX_INIT_H
+#define __SIM_LINUX_INIT_H
+
+#define __init
+#define __exit
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef __SIM_LINUX_KERNEL_H
+#define __SIM_LINUX_KERNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+
+#define KERN_ALERT ""
+#define KERN_ERR ""
+#define KERN_WARNING ""
+#define KERN_NOTICE ""
+#define KERN_INFO ""
+#define KERN_DEBUG ""
+
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *)&(x) = (val))
+
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((__typeof__(x))(a) - 1))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min3(a, b, c) min(min(a, b), c)
+#define min_t(type, a, b) min((type)(a), (type)(b))
+
+#define U16_MAX 65535
+#define U32_MAX 0xffffffffU
+#define U64_MAX 0xffffffffffffffffULL
+
+#define SMP_CACHE_BYTES 64
+
+#define smp_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+// kernel log output is dropped, the benchmark prints its own report
+static inline __attribute__((format(printf, 1, 2))) int printk(const char *fmt, ...)
+{
+    (void)fmt;
+    return 0;
+}
+
+#define pr_info(fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define pr_err(fmt, ...) printk(fmt, ##__VA_ARGS__)
+
+#endif
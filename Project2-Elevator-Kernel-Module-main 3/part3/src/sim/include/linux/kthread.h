@@ -0,0 +1,27 @@
+#ifndef __SIM_LINUX_KTHREAD_H
+#define __SIM_LINUX_KTHREAD_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#define current sim_current
+
+#define kthread_run(threadfn, data, namefmt, ...)                     \
+    ({                                                                \
+        char __name[16];                                              \
+        snprintf(__name, sizeof(__name), namefmt, ##__VA_ARGS__);     \
+        sim_task_create(threadfn, data, __name);                      \
+    })
+
+static inline int kthread_stop(struct task_struct *task)
+{
+    sim_task_stop(task);
+    return 0;
+}
+
+static inline bool kthread_should_stop(void)
+{
+    return sim_current && sim_current->should_stop;
+}
+
+#endif
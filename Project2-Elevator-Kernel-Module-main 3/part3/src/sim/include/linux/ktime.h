@@ -0,0 +1,28 @@
+#ifndef __SIM_LINUX_KTIME_H
+#define __SIM_LINUX_KTIME_H
+
+#include <linux/types.h>
+
+typedef s64 ktime_t;
+
+static inline s64 ktime_to_us(ktime_t kt)
+{
+    return kt / (s64)NSEC_PER_USEC;
+}
+
+static inline s64 ktime_us_delta(ktime_t later, ktime_t earlier)
+{
+    return ktime_to_us(later - earlier);
+}
+
+static inline ktime_t ktime_add_us(ktime_t kt, u64 usec)
+{
+    return kt + (s64)(usec * NSEC_PER_USEC);
+}
+
+static inline bool ktime_before(ktime_t cmp1, ktime_t cmp2)
+{
+    return cmp1 < cmp2;
+}
+
+#endif
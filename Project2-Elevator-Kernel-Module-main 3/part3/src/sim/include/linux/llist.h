@@ -0,0 +1,82 @@
+#ifndef __SIM_LINUX_LLIST_H
+#define __SIM_LINUX_LLIST_H
+
+#include <linux/kernel.h>
+
+// Lock-free singly linked list, safe to use from real threads
+struct llist_node
+{
+    struct llist_node *next;
+};
+
+struct llist_head
+{
+    struct llist_node *first;
+};
+
+#define LLIST_HEAD_INIT(name) { NULL }
+#define LLIST_HEAD(name) struct llist_head name = LLIST_HEAD_INIT(name)
+
+#define llist_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define member_address_is_nonnull(ptr, member) \
+    ((uintptr_t)(ptr) + offsetof(typeof(*(ptr)), member) != 0)
+
+#define llist_for_each_entry_safe(pos, n, node, member)                        \
+    for (pos = llist_entry((node), typeof(*pos), member);                      \
+         member_address_is_nonnull(pos, member) &&                             \
+         (n = llist_entry(pos->member.next, typeof(*n), member), true);        \
+         pos = n)
+
+static inline void init_llist_head(struct llist_head *list)
+{
+    list->first = NULL;
+}
+
+static inline bool llist_empty(const struct llist_head *head)
+{
+    return __atomic_load_n(&head->first, __ATOMIC_RELAXED) == NULL;
+}
+
+// Returns true if the list was empty before
+static inline bool llist_add_batch(struct llist_node *new_first, struct llist_node *new_last,
+                                   struct llist_head *head)
+{
+    struct llist_node *first = __atomic_load_n(&head->first, __ATOMIC_RELAXED);
+
+    do
+    {
+        new_last->next = first;
+    } while (!__atomic_compare_exchange_n(&head->first, &first, new_first, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return first == NULL;
+}
+
+static inline bool llist_add(struct llist_node *new, struct llist_head *head)
+{
+    return llist_add_batch(new, new, head);
+}
+
+static inline struct llist_node *llist_del_all(struct llist_head *head)
+{
+    return __atomic_exchange_n(&head->first, NULL, __ATOMIC_ACQUIRE);
+}
+
+static inline struct llist_node *llist_reverse_order(struct llist_node *head)
+{
+    struct llist_node *new_head = NULL;
+    struct llist_node *tmp;
+
+    while (head)
+    {
+        tmp = head;
+        head = head->next;
+        tmp->next = new_head;
+        new_head = tmp;
+    }
+
+    return new_head;
+}
+
+#endif
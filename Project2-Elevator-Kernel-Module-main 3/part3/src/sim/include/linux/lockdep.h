@@ -0,0 +1,11 @@
+#ifndef __SIM_LINUX_LOCKDEP_H
+#define __SIM_LINUX_LOCKDEP_H
+
+#include "kshim.h"
+
+// lock is a struct mutex or spinlock_t, checked against the locks this
+// thread holds
+#define lockdep_assert_held(lock) sim_lock_assert_held(lock, #lock)
+#define lockdep_is_held(lock) sim_lock_is_held(lock)
+
+#endif
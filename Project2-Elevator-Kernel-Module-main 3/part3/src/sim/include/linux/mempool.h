@@ -0,0 +1,40 @@
+#ifndef __SIM_LINUX_MEMPOOL_H
+#define __SIM_LINUX_MEMPOOL_H
+
+#include <linux/slab.h>
+
+// Userspace allocations do not fail, so the reserve is only bookkeeping.
+typedef struct mempool
+{
+    struct kmem_cache *cache;
+    int min_nr;
+} mempool_t;
+
+static inline mempool_t *mempool_create_slab_pool(int min_nr, struct kmem_cache *cache)
+{
+    mempool_t *pool = malloc(sizeof(mempool_t));
+
+    if (pool)
+    {
+        pool->cache = cache;
+        pool->min_nr = min_nr;
+    }
+    return pool;
+}
+
+static inline void *mempool_alloc(mempool_t *pool, int flags)
+{
+    return kmem_cache_alloc(pool->cache, flags);
+}
+
+static inline void mempool_free(void *element, mempool_t *pool)
+{
+    kmem_cache_free(pool->cache, element);
+}
+
+static inline void mempool_destroy(mempool_t *pool)
+{
+    free(pool);
+}
+
+#endif
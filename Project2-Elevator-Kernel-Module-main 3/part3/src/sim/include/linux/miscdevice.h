@@ -0,0 +1,26 @@
+#ifndef __SIM_LINUX_MISCDEVICE_H
+#define __SIM_LINUX_MISCDEVICE_H
+
+#include <linux/fs.h>
+
+#define MISC_DYNAMIC_MINOR 255
+
+// Nothing is created under /dev, the benchmark calls the fops directly
+struct miscdevice
+{
+    int minor;
+    const char *name;
+    const struct file_operations *fops;
+    unsigned short mode;
+};
+
+static inline int misc_register(struct miscdevice *misc)
+{
+    return 0;
+}
+
+static inline void misc_deregister(struct miscdevice *misc)
+{
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef __SIM_LINUX_MM_H
+#define __SIM_LINUX_MM_H
+
+#include <linux/slab.h>
+
+#define PAGE_SIZE 4096UL
+#define PAGE_ALIGN(addr) (((addr) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+// The mapping is the kernel buffer itself: the benchmark reads the address
+// back out of sim_addr instead of going through page tables.
+struct vm_area_struct
+{
+    unsigned long vm_start;
+    unsigned long vm_end;
+    unsigned long vm_pgoff;
+    void *sim_addr;
+};
+
+static inline int remap_vmalloc_range(struct vm_area_struct *vma, void *addr, unsigned long pgoff)
+{
+    vma->sim_addr = (char *)addr + pgoff * PAGE_SIZE;
+    return 0;
+}
+
+static inline void *kvcalloc(size_t n, size_t size, int flags)
+{
+    return kcalloc(n, size, flags);
+}
+
+static inline void kvfree(const void *ptr)
+{
+    kfree(ptr);
+}
+
+#endif
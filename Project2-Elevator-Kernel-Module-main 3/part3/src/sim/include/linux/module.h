@@ -0,0 +1,18 @@
+#ifndef __SIM_LINUX_MODULE_H
+#define __SIM_LINUX_MODULE_H
+
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include <linux/types.h>
+
+#define MODULE_LICENSE(license)
+#define MODULE_AUTHOR(author)
+#define MODULE_DESCRIPTION(description)
+#define EXPORT_SYMBOL(symbol)
+#define THIS_MODULE NULL
+
+// the benchmark calls the init/exit functions directly
+#define module_init(fn)
+#define module_exit(fn)
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef __SIM_LINUX_MODULEPARAM_H
+#define __SIM_LINUX_MODULEPARAM_H
+
+#include <stdlib.h>
+#include <linux/types.h>
+
+// Parameters register themselves at startup so the benchmark can set them
+// by name, the way insmod or a sysfs write would.
+#define module_param_cb(name, ops, arg, perm)                              \
+    static struct kernel_param __sim_param_##name = {#name, ops, arg, NULL}; \
+    __attribute__((constructor)) static void __sim_register_##name(void)  \
+    {                                                                      \
+        sim_param_register(&__sim_param_##name);                           \
+    }
+
+#define module_param_named(name, value, type, perm) \
+    module_param_cb(name, &param_ops_##type, &value, perm)
+
+// pasted here rather than passed on, where bool would expand to _Bool
+#define module_param(name, type, perm) module_param_cb(name, &param_ops_##type, &name, perm)
+
+#define MODULE_PARM_DESC(name, description)
+
+static inline int param_set_int(const char *val, const struct kernel_param *kp)
+{
+    char *end;
+    long value = strtol(val, &end, 0);
+
+    if (end == val)
+    {
+        return -EINVAL;
+    }
+    *(int *)kp->arg = value;
+    return 0;
+}
+
+static inline int param_get_int(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%d\n", *(int *)kp->arg);
+}
+
+static inline int param_set_uint(const char *val, const struct kernel_param *kp)
+{
+    char *end;
+    unsigned long value = strtoul(val, &end, 0);
+
+    if (end == val)
+    {
+        return -EINVAL;
+    }
+    *(unsigned int *)kp->arg = value;
+    return 0;
+}
+
+static inline int param_get_uint(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%u\n", *(unsigned int *)kp->arg);
+}
+
+static inline int param_set_bool(const char *val, const struct kernel_param *kp)
+{
+    switch (val[0])
+    {
+    case 'y':
+    case 'Y':
+    case '1':
+        *(bool *)kp->arg = true;
+        return 0;
+    case 'n':
+    case 'N':
+    case '0':
+        *(bool *)kp->arg = false;
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+static inline int param_get_bool(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%c\n", *(bool *)kp->arg ? 'Y' : 'N');
+}
+
+static const struct kernel_param_ops param_ops_int __attribute__((unused)) = {
+    .set = param_set_int,
+    .get = param_get_int,
+};
+
+static const struct kernel_param_ops param_ops_uint __attribute__((unused)) = {
+    .set = param_set_uint,
+    .get = param_get_uint,
+};
+
+static const struct kernel_param_ops param_ops_bool __attribute__((unused)) = {
+    .set = param_set_bool,
+    .get = param_get_bool,
+};
+
+#endif
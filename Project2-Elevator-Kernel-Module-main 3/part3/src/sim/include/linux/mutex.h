@@ -0,0 +1,60 @@
+#ifndef __SIM_LINUX_MUTEX_H
+#define __SIM_LINUX_MUTEX_H
+
+#include <pthread.h>
+#include <linux/lockdep.h>
+
+// Coroutine tasks never yield while holding a lock, so a real mutex never
+// blocks between them, but it does between the threads of contend. Every
+// lock and unlock goes through the lockdep checks in kshim.c.
+struct mutex
+{
+    pthread_mutex_t lock;
+    struct sim_lock_class lock_class;
+};
+
+#define DEFINE_MUTEX(name) struct mutex name = {PTHREAD_MUTEX_INITIALIZER, {#name, -1}}
+
+#define mutex_init(lock) sim_mutex_init(lock, #lock)
+
+static inline void sim_mutex_init(struct mutex *lock, const char *name)
+{
+    pthread_mutex_init(&lock->lock, NULL);
+    lock->lock_class.name = name;
+    lock->lock_class.id = -1;
+}
+
+static inline void mutex_lock(struct mutex *lock)
+{
+    sim_lock_acquire(lock, &lock->lock_class, 0);
+    pthread_mutex_lock(&lock->lock);
+}
+
+static inline int mutex_lock_interruptible(struct mutex *lock)
+{
+    mutex_lock(lock);
+    return 0;
+}
+
+static inline int mutex_trylock(struct mutex *lock)
+{
+    if (pthread_mutex_trylock(&lock->lock) != 0)
+    {
+        return 0;
+    }
+    sim_lock_acquire(lock, &lock->lock_class, 1);
+    return 1;
+}
+
+static inline void mutex_unlock(struct mutex *lock)
+{
+    sim_lock_release(lock);
+    pthread_mutex_unlock(&lock->lock);
+}
+
+static inline void mutex_destroy(struct mutex *lock)
+{
+    pthread_mutex_destroy(&lock->lock);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __SIM_LINUX_POLL_H
+#define __SIM_LINUX_POLL_H
+
+#include <sys/epoll.h>
+#include <linux/fs.h>
+#include <linux/wait.h>
+
+typedef unsigned int __poll_t;
+
+// Nothing sleeps in poll() here: the caller waits on the queue itself
+typedef struct poll_table_struct
+{
+    int unused;
+} poll_table;
+
+static inline void poll_wait(struct file *file, wait_queue_head_t *wq_head, poll_table *p)
+{
+    (void)file;
+    (void)wq_head;
+    (void)p;
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef __SIM_LINUX_PROC_FS_H
+#define __SIM_LINUX_PROC_FS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+#include <linux/seq_file.h>
+#include <linux/poll.h>
+
+// seq_read() hands out at most a page per read() call
+#define SIM_PAGE_SIZE 4096
+
+struct proc_ops
+{
+    int (*proc_open)(struct inode *inode, struct file *file);
+    ssize_t (*proc_read)(struct file *file, char __user *ubuf, size_t count, loff_t *ppos);
+    ssize_t (*proc_write)(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos);
+    loff_t (*proc_lseek)(struct file *file, loff_t offset, int whence);
+    int (*proc_release)(struct inode *inode, struct file *file);
+    __poll_t (*proc_poll)(struct file *file, struct poll_table_struct *pt);
+};
+
+struct proc_dir_entry
+{
+    const char *name;
+    const struct proc_ops *proc_ops;
+    const struct seq_operations *seq_ops;
+};
+
+static inline struct proc_dir_entry *proc_create(const char *name, unsigned short mode,
+                                                 struct proc_dir_entry *parent,
+                                                 const struct proc_ops *proc_ops)
+{
+    struct proc_dir_entry *entry = malloc(sizeof(struct proc_dir_entry));
+
+    (void)mode;
+    (void)parent;
+    if (entry)
+    {
+        entry->name = name;
+        entry->proc_ops = proc_ops;
+        entry->seq_ops = NULL;
+    }
+    return entry;
+}
+
+static inline struct proc_dir_entry *proc_create_seq(const char *name, unsigned short mode,
+                                                     struct proc_dir_entry *parent,
+                                                     const struct seq_operations *ops)
+{
+    struct proc_dir_entry *entry = proc_create(name, mode, parent, NULL);
+
+    if (entry)
+    {
+        entry->seq_ops = ops;
+    }
+    return entry;
+}
+
+static inline void proc_remove(struct proc_dir_entry *entry)
+{
+    free(entry);
+}
+
+// Reads a seq_file entry to the end the way seq_read() would: a page per
+// read() call, restarting the iterator at the saved position each time.
+// Returns a NUL-terminated buffer for the caller to free.
+static inline char *sim_proc_read(struct proc_dir_entry *entry, size_t *len)
+{
+    struct file file = {0};
+    struct seq_file *m;
+    char *out = NULL;
+    size_t out_len = 0;
+    loff_t pos = 0;
+    void *v;
+
+    if (entry->seq_ops)
+    {
+        seq_open(&file, entry->seq_ops);
+    }
+    else
+    {
+        entry->proc_ops->proc_open(NULL, &file);
+    }
+    m = file.private_data;
+
+    for (;;)
+    {
+        m->count = 0;
+        v = m->op->start(m, &pos);
+        while (v && m->count < SIM_PAGE_SIZE)
+        {
+            m->op->show(m, v);
+            v = m->op->next(m, v, &pos);
+        }
+        m->op->stop(m, v);
+
+        out = realloc(out, out_len + m->count + 1);
+        if (m->count)
+        {
+            memcpy(out + out_len, m->buf, m->count);
+        }
+        out_len += m->count;
+        if (!v)
+        {
+            break;
+        }
+    }
+
+    if (entry->seq_ops)
+    {
+        seq_release(NULL, &file);
+    }
+    else
+    {
+        entry->proc_ops->proc_release(NULL, &file);
+    }
+
+    out[out_len] = '\0';
+    *len = out_len;
+    return out;
+}
+
+// A write() of the whole buffer at offset 0
+static inline ssize_t sim_proc_write(struct proc_dir_entry *entry, const char *buf, size_t len)
+{
+    struct file file = {0};
+    loff_t pos = 0;
+
+    return entry->proc_ops->proc_write(&file, buf, len, &pos);
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __SIM_LINUX_RCULIST_H
+#define __SIM_LINUX_RCULIST_H
+
+#include <linux/list.h>
+
+// The entry is filled in before it is published, for readers that peek at
+// the list without its lock
+static inline void list_add_tail_rcu(struct list_head *entry, struct list_head *head)
+{
+    struct list_head *prev = head->prev;
+
+    entry->next = head;
+    entry->prev = prev;
+    __atomic_store_n(&prev->next, entry, __ATOMIC_RELEASE);
+    head->prev = entry;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef __SIM_LINUX_RCUPDATE_H
+#define __SIM_LINUX_RCUPDATE_H
+
+#include <linux/types.h>
+
+// Read-side sections and grace periods are tracked per thread by kshim.c,
+// so kfree_rcu() holds off the free for readers on real threads too
+
+static inline void rcu_read_lock(void)
+{
+    sim_rcu_read_lock();
+}
+
+static inline void rcu_read_unlock(void)
+{
+    sim_rcu_read_unlock();
+}
+
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define rcu_dereference_protected(p, c) ((void)(c), (p))
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define RCU_INIT_POINTER(p, v) ((p) = (v))
+#define rcu_replace_pointer(p, v, c)                                    \
+    ({                                                                  \
+        __typeof__(p) __old = rcu_dereference_protected(p, c);          \
+        rcu_assign_pointer(p, v);                                       \
+        __old;                                                          \
+    })
+
+#define kfree_rcu(ptr, field) sim_kfree_rcu(&(ptr)->field, (ptr))
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __SIM_LINUX_SCHED_CLOCK_H
+#define __SIM_LINUX_SCHED_CLOCK_H
+
+#include <time.h>
+#include <linux/types.h>
+
+// real time, for measuring how long code takes rather than simulated time
+static inline u64 local_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+#endif
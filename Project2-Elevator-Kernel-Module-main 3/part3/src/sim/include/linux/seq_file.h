@@ -0,0 +1,106 @@
+#ifndef __SIM_LINUX_SEQ_FILE_H
+#define __SIM_LINUX_SEQ_FILE_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+#include <linux/fs.h>
+
+struct seq_operations;
+
+struct seq_file
+{
+    char *buf;
+    size_t size;
+    size_t count;
+    const struct seq_operations *op;
+    void *private;
+};
+
+struct seq_operations
+{
+    void *(*start)(struct seq_file *m, loff_t *pos);
+    void (*stop)(struct seq_file *m, void *v);
+    void *(*next)(struct seq_file *m, void *v, loff_t *pos);
+    int (*show)(struct seq_file *m, void *v);
+};
+
+// The kernel retries a record that overflows with a bigger buffer, here
+// the buffer just grows.
+static inline void seq_reserve(struct seq_file *m, size_t len)
+{
+    if (m->count + len + 1 > m->size)
+    {
+        m->size = (m->count + len + 1) * 2;
+        m->buf = realloc(m->buf, m->size);
+    }
+}
+
+__attribute__((format(printf, 2, 3)))
+static inline void seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    seq_reserve(m, len);
+    va_start(args, fmt);
+    vsnprintf(m->buf + m->count, len + 1, fmt, args);
+    va_end(args);
+    m->count += len;
+}
+
+static inline void seq_puts(struct seq_file *m, const char *s)
+{
+    size_t len = strlen(s);
+
+    seq_reserve(m, len);
+    memcpy(m->buf + m->count, s, len);
+    m->count += len;
+}
+
+static inline void seq_putc(struct seq_file *m, char c)
+{
+    seq_reserve(m, 1);
+    m->buf[m->count++] = c;
+}
+
+static inline int seq_open(struct file *file, const struct seq_operations *op)
+{
+    struct seq_file *m = calloc(1, sizeof(struct seq_file));
+
+    if (!m)
+    {
+        return -ENOMEM;
+    }
+    m->op = op;
+    file->private_data = m;
+    return 0;
+}
+
+static inline int seq_release(struct inode *inode, struct file *file)
+{
+    struct seq_file *m = file->private_data;
+
+    free(m->buf);
+    free(m);
+    return 0;
+}
+
+// Only there to fill in proc_ops, sim_proc_read() runs the iterator itself
+static inline ssize_t seq_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+{
+    return -EINVAL;
+}
+
+static inline loff_t seq_lseek(struct file *file, loff_t offset, int whence)
+{
+    return -EINVAL;
+}
+
+#endif
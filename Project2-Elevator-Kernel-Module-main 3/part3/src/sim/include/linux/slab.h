@@ -0,0 +1,87 @@
+#ifndef __SIM_LINUX_SLAB_H
+#define __SIM_LINUX_SLAB_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+
+#define GFP_KERNEL 0
+#define GFP_ATOMIC 1
+
+#define SLAB_HWCACHE_ALIGN 0x2000
+
+// size of a struct with count elements in its flexible array member
+#define struct_size(p, member, count) (sizeof(*(p)) + (size_t)(count) * sizeof((p)->member[0]))
+
+static inline void *kmalloc(size_t size, int flags)
+{
+    (void)flags;
+    return sim_alloc(size);
+}
+
+static inline void *kzalloc(size_t size, int flags)
+{
+    void *ptr = kmalloc(size, flags);
+
+    if (ptr)
+    {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+static inline void *kmalloc_array(size_t n, size_t size, int flags)
+{
+    return kmalloc(n * size, flags);
+}
+
+static inline void *kcalloc(size_t n, size_t size, int flags)
+{
+    return kzalloc(n * size, flags);
+}
+
+static inline void kfree(const void *ptr)
+{
+    sim_free((void *)ptr);
+}
+
+struct kmem_cache
+{
+    const char *name;
+    size_t size;
+};
+
+static inline struct kmem_cache *kmem_cache_create(const char *name, unsigned int size,
+                                                   unsigned int align, unsigned long flags,
+                                                   void (*ctor)(void *))
+{
+    struct kmem_cache *cache = malloc(sizeof(struct kmem_cache));
+
+    (void)align;
+    (void)flags;
+    (void)ctor;
+    if (cache)
+    {
+        cache->name = name;
+        cache->size = size;
+    }
+    return cache;
+}
+
+static inline void *kmem_cache_alloc(struct kmem_cache *cache, int flags)
+{
+    return kmalloc(cache->size, flags);
+}
+
+static inline void kmem_cache_free(struct kmem_cache *cache, void *ptr)
+{
+    (void)cache;
+    kfree(ptr);
+}
+
+static inline void kmem_cache_destroy(struct kmem_cache *cache)
+{
+    free(cache);
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __SIM_LINUX_SPINLOCK_H
+#define __SIM_LINUX_SPINLOCK_H
+
+#include <pthread.h>
+#include <linux/lockdep.h>
+
+// As with struct mutex, only the threads of contend ever contend on it
+typedef struct
+{
+    pthread_mutex_t lock;
+    struct sim_lock_class lock_class;
+} spinlock_t;
+
+#define DEFINE_SPINLOCK(name) spinlock_t name = {PTHREAD_MUTEX_INITIALIZER, {#name, -1}}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+    sim_lock_acquire(lock, &lock->lock_class, 0);
+    pthread_mutex_lock(&lock->lock);
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+    sim_lock_release(lock);
+    pthread_mutex_unlock(&lock->lock);
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __SIM_LINUX_STRING_H
+#define __SIM_LINUX_STRING_H
+
+#include <stdbool.h>
+#include <string.h>
+
+// compares two strings, ignoring a single trailing newline on either
+static inline bool sysfs_streq(const char *s1, const char *s2)
+{
+    while (*s1 && *s1 == *s2)
+    {
+        s1++;
+        s2++;
+    }
+
+    if (*s1 == *s2)
+    {
+        return true;
+    }
+    if (!*s1 && *s2 == '\n' && !s2[1])
+    {
+        return true;
+    }
+    if (*s1 == '\n' && !s1[1] && !*s2)
+    {
+        return true;
+    }
+    return false;
+}
+
+#endif
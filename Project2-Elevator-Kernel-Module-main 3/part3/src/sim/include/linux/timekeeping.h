@@ -0,0 +1,23 @@
+#ifndef __SIM_LINUX_TIMEKEEPING_H
+#define __SIM_LINUX_TIMEKEEPING_H
+
+#include <linux/ktime.h>
+
+// the monotonic clock is the virtual clock
+static inline ktime_t ktime_get(void)
+{
+    return sim_clock_ns;
+}
+
+static inline u64 ktime_get_ns(void)
+{
+    return sim_clock_ns;
+}
+
+// wall clock seconds, the run starting at midnight UTC
+static inline time64_t ktime_get_real_seconds(void)
+{
+    return sim_clock_ns / NSEC_PER_SEC;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __SIM_LINUX_TRACEPOINT_H
+#define __SIM_LINUX_TRACEPOINT_H
+
+// TRACE_EVENT() becomes a plain function that formats the event with its
+// TP_printk() and writes it to sim_trace_file, stamped with the virtual
+// clock the way ftrace stamps it. With no file set it is a single test.
+
+#include <stdio.h>
+#include <linux/types.h>
+
+extern FILE *sim_trace_file;
+
+struct trace_print_flags
+{
+    unsigned long mask;
+    const char *name;
+};
+
+static inline const char *sim_print_symbolic(unsigned long value, const struct trace_print_flags *symbols)
+{
+    for (; symbols->name; symbols++)
+    {
+        if (symbols->mask == value)
+        {
+            return symbols->name;
+        }
+    }
+    return "?";
+}
+
+#define __print_symbolic(value, symbols...) \
+    sim_print_symbolic(value, (const struct trace_print_flags[]){symbols, {0, NULL}})
+
+#define TP_PROTO(args...) args
+#define TP_ARGS(args...) args
+#define TP_STRUCT__entry(args...) args
+#define TP_fast_assign(args...) args
+#define TP_printk(fmt, args...) fmt "\n", args
+#define __field(type, item) type item;
+
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print)                   \
+    struct trace_event_raw_##name                                                \
+    {                                                                            \
+        tstruct                                                                  \
+    };                                                                           \
+    static inline void trace_##name(proto)                                       \
+    {                                                                            \
+        struct trace_event_raw_##name __raw, *__entry = &__raw;                  \
+                                                                                 \
+        if (!sim_trace_file)                                                     \
+        {                                                                        \
+            return;                                                              \
+        }                                                                        \
+        assign                                                                   \
+        fprintf(sim_trace_file, "%llu.%06llu: " #name ": ",                      \
+                sim_clock_ns / NSEC_PER_SEC, sim_clock_ns % NSEC_PER_SEC / NSEC_PER_USEC); \
+        fprintf(sim_trace_file, print);                                          \
+    }
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef __SIM_LINUX_TYPES_H
+#define __SIM_LINUX_TYPES_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "kshim.h"
+
+#define __user
+#define __rcu
+
+#endif
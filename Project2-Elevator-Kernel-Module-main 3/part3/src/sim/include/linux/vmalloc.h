@@ -0,0 +1,16 @@
+#ifndef __SIM_LINUX_VMALLOC_H
+#define __SIM_LINUX_VMALLOC_H
+
+#include <stdlib.h>
+
+static inline void *vmalloc_user(unsigned long size)
+{
+    return calloc(1, size);
+}
+
+static inline void vfree(const void *addr)
+{
+    free((void *)addr);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __SIM_LINUX_WAIT_H
+#define __SIM_LINUX_WAIT_H
+
+#include <linux/types.h>
+
+// A waiting task is parked in the scheduler until someone wakes its queue,
+// then re-checks its condition.
+struct wait_queue_head
+{
+    int unused;
+};
+
+typedef struct wait_queue_head wait_queue_head_t;
+
+#define DECLARE_WAIT_QUEUE_HEAD(name) struct wait_queue_head name = {0}
+
+static inline void init_waitqueue_head(struct wait_queue_head *wq_head)
+{
+    (void)wq_head;
+}
+
+#define wait_event(wq_head, condition)  \
+    do                                  \
+    {                                   \
+        while (!(condition))            \
+        {                               \
+            sim_wait(&(wq_head));       \
+        }                               \
+    } while (0)
+
+#define wait_event_interruptible(wq_head, condition) \
+    ({                                               \
+        wait_event(wq_head, condition);              \
+        0;                                           \
+    })
+
+#define wake_up(wq_head) sim_wake(wq_head)
+#define wake_up_interruptible(wq_head) sim_wake(wq_head)
+#define wake_up_all(wq_head) sim_wake(wq_head)
+
+// waking an empty queue is cheap enough here
+static inline bool wq_has_sleeper(struct wait_queue_head *wq_head)
+{
+    return true;
+}
+
+#endif
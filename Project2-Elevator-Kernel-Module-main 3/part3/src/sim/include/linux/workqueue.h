@@ -0,0 +1,77 @@
+#ifndef __SIM_LINUX_WORKQUEUE_H
+#define __SIM_LINUX_WORKQUEUE_H
+
+#include <stdlib.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+
+// A queued work item is an event due now, run by the scheduler outside any
+// task. pending is set without the event lock, as the kernel sets
+// WORK_STRUCT_PENDING, so requeueing a queued item stays cheap.
+struct work_struct
+{
+    struct sim_event event;
+    void (*func)(struct work_struct *work);
+    int pending;
+};
+
+struct workqueue_struct
+{
+    int unused;
+};
+
+#define WQ_UNBOUND 0
+
+static inline void sim_run_work(struct sim_event *event)
+{
+    struct work_struct *work = container_of(event, struct work_struct, event);
+
+    __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+    work->func(work);
+}
+
+#define INIT_WORK(_work, _func)                  \
+    do                                           \
+    {                                            \
+        (_work)->event.fn = sim_run_work;        \
+        (_work)->event.queued = 0;               \
+        (_work)->func = (_func);                 \
+        (_work)->pending = 0;                    \
+    } while (0)
+
+static inline bool queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+    if (__atomic_exchange_n(&work->pending, 1, __ATOMIC_ACQ_REL))
+    {
+        return false;
+    }
+    sim_event_add(&work->event, sim_clock_ns, 0);
+    return true;
+}
+
+// nothing runs concurrently with the caller, so there is nothing to wait for
+static inline bool cancel_work_sync(struct work_struct *work)
+{
+    bool was_pending = sim_event_del(&work->event);
+
+    __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+    return was_pending;
+}
+
+// Work only runs from sim_run(), and the module is never unloaded from
+// inside it, so nothing queued is in flight here either
+static inline void flush_workqueue(struct workqueue_struct *wq)
+{
+}
+
+static inline struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags, int max_active)
+{
+    return calloc(1, sizeof(struct workqueue_struct));
+}
+
+static inline void destroy_workqueue(struct workqueue_struct *wq)
+{
+    free(wq);
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef __SIM_TRACE_DEFINE_TRACE_H
+#define __SIM_TRACE_DEFINE_TRACE_H
+
+// The events were fully defined on the first read of the trace header,
+// there is no second pass to make
+
+#endif
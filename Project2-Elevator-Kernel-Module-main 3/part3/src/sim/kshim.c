@@ -0,0 +1,584 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "kshim.h"
+
+#define SIM_STACK_SIZE (256 * 1024)
+#define SIM_LOCK_CLASSES 64
+#define SIM_HELD_LOCKS 16
+#define SIM_RCU_READERS 64
+
+u64 sim_clock_ns = 0;
+struct task_struct *sim_current = NULL;
+
+void (*sim_step_hook)(struct task_struct *task) = NULL;
+void (*sim_event_hook)(struct sim_event *event, u64 cpu_ns) = NULL;
+void (*sim_free_hook)(void *ptr) = NULL;
+
+FILE *sim_trace_file = NULL;
+int sim_lockdep_reports = 0;
+
+static struct task_struct *task_list = NULL;
+static struct sim_event *event_list = NULL;
+// contend queues work from real threads
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct kernel_param *param_list = NULL;
+
+static const char *lock_class_names[SIM_LOCK_CLASSES];
+static int num_lock_classes = 0;
+static pthread_mutex_t lock_class_lock = PTHREAD_MUTEX_INITIALIZER;
+// lock_order[a][b] is 1 once class b was taken with a held, 2 once that
+// was reported
+static unsigned char lock_order[SIM_LOCK_CLASSES][SIM_LOCK_CLASSES];
+// locks held by this thread, innermost last; tasks never yield holding one
+static __thread struct
+{
+    void *lock;
+    int class_id;
+} held_locks[SIM_HELD_LOCKS];
+static __thread int num_held_locks = 0;
+
+// Grace periods are counted in epochs. A reader records the epoch it began
+// in, 0 when it is outside any read-side section; an object retired in an
+// epoch is freed once every reader began after it.
+static u64 rcu_epoch = 1;
+static u64 rcu_reader_epochs[SIM_RCU_READERS];
+static int rcu_slots_used[SIM_RCU_READERS];
+static pthread_key_t rcu_slot_key;
+static pthread_once_t rcu_slot_once = PTHREAD_ONCE_INIT;
+static __thread int rcu_slot = -1;
+static __thread int rcu_nesting = 0;
+static struct rcu_head *rcu_retired = NULL;
+static struct rcu_head **rcu_retired_tail = &rcu_retired;
+static pthread_mutex_t rcu_lock = PTHREAD_MUTEX_INITIALIZER;
+static ucontext_t scheduler_context;
+
+/*===========================================================================*/
+/*===============================Task Functions==============================*/
+/*===========================================================================*/
+
+static u64 thread_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void task_trampoline(void)
+{
+    struct task_struct *task = sim_current;
+
+    task->threadfn(task->data);
+    task->exited = 1;
+    // returning resumes scheduler_context through uc_link
+}
+
+struct task_struct *sim_task_create(int (*threadfn)(void *data), void *data, const char *name)
+{
+    struct task_struct *task = calloc(1, sizeof(struct task_struct));
+    struct task_struct **tail;
+
+    if (!task)
+    {
+        return NULL;
+    }
+
+    task->stack = malloc(SIM_STACK_SIZE);
+    if (!task->stack)
+    {
+        free(task);
+        return NULL;
+    }
+
+    snprintf(task->comm, sizeof(task->comm), "%s", name);
+    task->threadfn = threadfn;
+    task->data = data;
+    task->wake_ns = sim_clock_ns;
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = SIM_STACK_SIZE;
+    task->context.uc_link = &scheduler_context;
+    makecontext(&task->context, task_trampoline, 0);
+
+    // keep creation order so ties on the clock resolve deterministically
+    for (tail = &task_list; *tail; tail = &(*tail)->next)
+        ;
+    *tail = task;
+
+    return task;
+}
+
+void sim_task_stop(struct task_struct *task)
+{
+    task->should_stop = 1;
+    task->blocked_on = NULL;
+    if (task->wake_ns > sim_clock_ns)
+    {
+        task->wake_ns = sim_clock_ns;
+    }
+}
+
+void sim_sleep_ns(u64 ns)
+{
+    struct task_struct *task = sim_current;
+
+    if (!task)
+    {
+        // called outside any task: just let time pass
+        sim_clock_ns += ns;
+        return;
+    }
+
+    task->wake_ns = sim_clock_ns + ns;
+    task->steps++;
+    swapcontext(&task->context, &scheduler_context);
+}
+
+void sim_wait(void *queue)
+{
+    struct task_struct *task = sim_current;
+
+    if (!task)
+    {
+        // called from a plain thread: the caller spins on its condition
+        return;
+    }
+
+    task->blocked_on = queue;
+    task->steps++;
+    swapcontext(&task->context, &scheduler_context);
+}
+
+void sim_wake(void *queue)
+{
+    struct task_struct *task;
+
+    for (task = task_list; task; task = task->next)
+    {
+        if (task->blocked_on == queue)
+        {
+            task->blocked_on = NULL;
+            task->wake_ns = sim_clock_ns;
+        }
+    }
+}
+
+// Unlinks and returns the earliest event due no later than limit_ns
+static struct sim_event *take_event(u64 limit_ns)
+{
+    struct sim_event **link, **first = NULL;
+    struct sim_event *event;
+
+    pthread_mutex_lock(&event_lock);
+    for (link = &event_list; *link; link = &(*link)->next)
+    {
+        if ((*link)->expires_ns <= limit_ns && (!first || (*link)->expires_ns < (*first)->expires_ns))
+        {
+            first = link;
+        }
+    }
+
+    event = first ? *first : NULL;
+    if (event)
+    {
+        *first = event->next;
+        event->queued = 0;
+    }
+    pthread_mutex_unlock(&event_lock);
+
+    return event;
+}
+
+void sim_run(void)
+{
+    struct task_struct *task, *next, **link;
+    struct sim_event *event;
+    u64 cpu_start, cpu_ns;
+
+    for (;;)
+    {
+        next = NULL;
+        for (task = task_list; task; task = task->next)
+        {
+            if (!task->exited && !task->blocked_on && (!next || task->wake_ns < next->wake_ns))
+            {
+                next = task;
+            }
+        }
+
+        event = take_event(next ? next->wake_ns : UINT64_MAX);
+        if (event)
+        {
+            if (event->expires_ns > sim_clock_ns)
+            {
+                sim_clock_ns = event->expires_ns;
+            }
+
+            cpu_start = thread_cpu_ns();
+            event->fn(event);
+            cpu_ns = thread_cpu_ns() - cpu_start;
+
+            if (sim_event_hook)
+            {
+                sim_event_hook(event, cpu_ns);
+            }
+            continue;
+        }
+
+        if (!next)
+        {
+            // everything left is blocked on a wait queue nobody will wake
+            break;
+        }
+
+        if (next->wake_ns > sim_clock_ns)
+        {
+            sim_clock_ns = next->wake_ns;
+        }
+
+        sim_current = next;
+        cpu_start = thread_cpu_ns();
+        swapcontext(&scheduler_context, &next->context);
+        next->cpu_ns += thread_cpu_ns() - cpu_start;
+        sim_current = NULL;
+
+        if (sim_step_hook)
+        {
+            sim_step_hook(next);
+        }
+    }
+
+    // reap finished tasks
+    link = &task_list;
+    while ((task = *link))
+    {
+        *link = task->next;
+        free(task->stack);
+        free(task);
+    }
+}
+
+/*===========================================================================*/
+/*==============================Event Functions==============================*/
+/*===========================================================================*/
+
+// Queues the event to run at expires_ns. An event that is already queued
+// keeps its time unless rearm is set. Returns whether it was queued before.
+int sim_event_add(struct sim_event *event, u64 expires_ns, int rearm)
+{
+    struct sim_event **tail;
+    int was_queued;
+
+    pthread_mutex_lock(&event_lock);
+    was_queued = event->queued;
+    if (was_queued && rearm)
+    {
+        event->expires_ns = expires_ns;
+    }
+    else if (!was_queued)
+    {
+        event->expires_ns = expires_ns;
+        event->queued = 1;
+        event->next = NULL;
+        for (tail = &event_list; *tail; tail = &(*tail)->next)
+            ;
+        *tail = event;
+    }
+    pthread_mutex_unlock(&event_lock);
+
+    return was_queued;
+}
+
+// Returns whether the event was queued
+int sim_event_del(struct sim_event *event)
+{
+    struct sim_event **link;
+    int was_queued;
+
+    pthread_mutex_lock(&event_lock);
+    was_queued = event->queued;
+    for (link = &event_list; was_queued && *link; link = &(*link)->next)
+    {
+        if (*link == event)
+        {
+            *link = event->next;
+            break;
+        }
+    }
+    event->queued = 0;
+    pthread_mutex_unlock(&event_lock);
+
+    return was_queued;
+}
+
+/*===========================================================================*/
+/*=============================Lockdep Functions=============================*/
+/*===========================================================================*/
+
+static int lock_class_id(struct sim_lock_class *lock_class)
+{
+    int id = __atomic_load_n(&lock_class->id, __ATOMIC_ACQUIRE);
+
+    if (id >= 0)
+    {
+        return id;
+    }
+
+    pthread_mutex_lock(&lock_class_lock);
+    for (id = 0; id < num_lock_classes && strcmp(lock_class_names[id], lock_class->name) != 0; ++id)
+        ;
+    if (id == num_lock_classes && num_lock_classes < SIM_LOCK_CLASSES)
+    {
+        lock_class_names[num_lock_classes++] = lock_class->name;
+    }
+    pthread_mutex_unlock(&lock_class_lock);
+
+    id = id < SIM_LOCK_CLASSES ? id : SIM_LOCK_CLASSES - 1;
+    __atomic_store_n(&lock_class->id, id, __ATOMIC_RELEASE);
+    return id;
+}
+
+static void lockdep_report(const char *what, int held, int taken)
+{
+    fprintf(stderr, "lockdep: %s: %s while holding %s\n", what, lock_class_names[taken],
+            lock_class_names[held]);
+    __atomic_add_fetch(&sim_lockdep_reports, 1, __ATOMIC_RELAXED);
+}
+
+// Checks the lock against everything this thread holds, the way lockdep
+// would. A trylock cannot deadlock, so it only adds the lock to the held set.
+void sim_lock_acquire(void *lock, struct sim_lock_class *lock_class, int trylock)
+{
+    int id = lock_class_id(lock_class);
+    int held;
+
+    for (int i = 0; i < num_held_locks && !trylock; ++i)
+    {
+        held = held_locks[i].class_id;
+        if (held == id)
+        {
+            lockdep_report("possible recursive locking", held, id);
+            continue;
+        }
+
+        // racy, but a pair is only ever set, then marked reported
+        if (lock_order[id][held] && lock_order[held][id] != 2)
+        {
+            lock_order[held][id] = lock_order[id][held] = 2;
+            lockdep_report("possible circular locking", held, id);
+        }
+        else if (!lock_order[held][id])
+        {
+            lock_order[held][id] = 1;
+        }
+    }
+
+    if (num_held_locks < SIM_HELD_LOCKS)
+    {
+        held_locks[num_held_locks].lock = lock;
+        held_locks[num_held_locks].class_id = id;
+        num_held_locks++;
+    }
+}
+
+void sim_lock_release(void *lock)
+{
+    for (int i = num_held_locks - 1; i >= 0; --i)
+    {
+        if (held_locks[i].lock == lock)
+        {
+            memmove(&held_locks[i], &held_locks[i + 1], sizeof(held_locks[0]) * (num_held_locks - i - 1));
+            num_held_locks--;
+            return;
+        }
+    }
+}
+
+int sim_lock_is_held(void *lock)
+{
+    for (int i = 0; i < num_held_locks; ++i)
+    {
+        if (held_locks[i].lock == lock)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void sim_lock_assert_held(void *lock, const char *name)
+{
+    if (sim_lock_is_held(lock))
+    {
+        return;
+    }
+
+    fprintf(stderr, "lockdep: %s not held\n", name);
+    __atomic_add_fetch(&sim_lockdep_reports, 1, __ATOMIC_RELAXED);
+}
+
+/*===========================================================================*/
+/*===============================RCU Functions===============================*/
+/*===========================================================================*/
+
+// A thread's reader slot is given back when it exits
+static void rcu_slot_release(void *slot)
+{
+    __atomic_store_n(&rcu_slots_used[(uintptr_t)slot - 1], 0, __ATOMIC_RELEASE);
+}
+
+static void rcu_slot_init(void)
+{
+    pthread_key_create(&rcu_slot_key, rcu_slot_release);
+}
+
+static int rcu_slot_claim(void)
+{
+    int expected;
+
+    pthread_once(&rcu_slot_once, rcu_slot_init);
+    for (int i = 0; i < SIM_RCU_READERS; ++i)
+    {
+        expected = 0;
+        if (__atomic_compare_exchange_n(&rcu_slots_used[i], &expected, 1, 0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED))
+        {
+            pthread_setspecific(rcu_slot_key, (void *)(uintptr_t)(i + 1));
+            return i;
+        }
+    }
+
+    fprintf(stderr, "rcu: more than %d reader threads\n", SIM_RCU_READERS);
+    abort();
+}
+
+void sim_rcu_read_lock(void)
+{
+    if (rcu_nesting++ > 0)
+    {
+        return;
+    }
+
+    if (rcu_slot < 0)
+    {
+        rcu_slot = rcu_slot_claim();
+    }
+
+    // seen by sim_kfree_rcu() before this reader loads any pointer
+    __atomic_store_n(&rcu_reader_epochs[rcu_slot], __atomic_load_n(&rcu_epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+}
+
+void sim_rcu_read_unlock(void)
+{
+    if (--rcu_nesting == 0)
+    {
+        __atomic_store_n(&rcu_reader_epochs[rcu_slot], 0, __ATOMIC_RELEASE);
+    }
+}
+
+// Frees everything retired before the oldest read-side section still
+// running began. Caller holds rcu_lock.
+static void rcu_reclaim(void)
+{
+    u64 oldest = UINT64_MAX;
+    struct rcu_head *head;
+    u64 epoch;
+
+    for (int i = 0; i < SIM_RCU_READERS; ++i)
+    {
+        epoch = __atomic_load_n(&rcu_reader_epochs[i], __ATOMIC_SEQ_CST);
+        if (epoch && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+
+    while (rcu_retired && rcu_retired->epoch < oldest)
+    {
+        head = rcu_retired;
+        rcu_retired = head->next;
+        sim_free(head->ptr);
+    }
+    if (!rcu_retired)
+    {
+        rcu_retired_tail = &rcu_retired;
+    }
+}
+
+// The object must already be unpublished. It is freed here, or by a later
+// call, once no reader can still hold it.
+void sim_kfree_rcu(struct rcu_head *head, void *ptr)
+{
+    pthread_mutex_lock(&rcu_lock);
+    head->ptr = ptr;
+    head->next = NULL;
+    head->epoch = __atomic_fetch_add(&rcu_epoch, 1, __ATOMIC_SEQ_CST);
+    *rcu_retired_tail = head;
+    rcu_retired_tail = &head->next;
+    rcu_reclaim();
+    pthread_mutex_unlock(&rcu_lock);
+}
+
+/*===========================================================================*/
+/*=============================Param Functions===============================*/
+/*===========================================================================*/
+
+void sim_param_register(struct kernel_param *kp)
+{
+    kp->next = param_list;
+    param_list = kp;
+}
+
+int sim_param_set(const char *name, const char *val)
+{
+    struct kernel_param *kp;
+
+    for (kp = param_list; kp; kp = kp->next)
+    {
+        if (strcmp(kp->name, name) == 0)
+        {
+            return kp->ops->set(val, kp);
+        }
+    }
+
+    return -1;
+}
+
+/*===========================================================================*/
+/*============================Allocation Functions===========================*/
+/*===========================================================================*/
+
+void *sim_alloc(size_t size)
+{
+    struct sim_obj *obj = malloc(sizeof(struct sim_obj) + size);
+
+    if (!obj)
+    {
+        return NULL;
+    }
+
+    obj->born_ns = sim_clock_ns;
+    obj->mark_ns = 0;
+    obj->tag = 0;
+    return obj + 1;
+}
+
+void sim_free(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    if (sim_free_hook)
+    {
+        sim_free_hook(ptr);
+    }
+    free(sim_obj(ptr));
+}
@@ -0,0 +1,139 @@
+#ifndef __KSHIM_H
+#define __KSHIM_H
+
+// Userspace runtime behind the include/linux shims. Kernel threads become
+// coroutines driven by a discrete-event scheduler on a virtual clock, so a
+// sleep costs nothing but a context switch.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+// fixed-width types as the kernel spells them, so format strings agree
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef s64 time64_t;
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+struct task_struct
+{
+    char comm[16];
+    int (*threadfn)(void *data);
+    void *data;
+    int should_stop;
+    int exited;
+    u64 wake_ns;
+    void *blocked_on;
+    u64 steps;
+    u64 cpu_ns;
+    void *stack;
+    ucontext_t context;
+    struct task_struct *next;
+};
+
+// A timer or work item, run by the scheduler outside any task once the
+// clock reaches expires_ns. Events due at the same time run in the order
+// they were added, and before any task due then.
+struct sim_event
+{
+    u64 expires_ns;
+    void (*fn)(struct sim_event *event);
+    int queued;
+    struct sim_event *next;
+};
+
+// Lock class, named after where the lock is defined or initialized, so
+// every lock set up by the same line shares one, as with lockdep keys
+struct sim_lock_class
+{
+    const char *name;
+    int id;
+};
+
+// An object waiting out an RCU grace period, freed once every read-side
+// section that began before it was retired has ended
+struct rcu_head
+{
+    struct rcu_head *next;
+    u64 epoch;
+    void *ptr;
+};
+
+struct kernel_param;
+
+struct kernel_param_ops
+{
+    int (*set)(const char *val, const struct kernel_param *kp);
+    int (*get)(char *buffer, const struct kernel_param *kp);
+};
+
+struct kernel_param
+{
+    const char *name;
+    const struct kernel_param_ops *ops;
+    void *arg;
+    struct kernel_param *next;
+};
+
+// Kernel objects are allocated with this header in front of them so the
+// benchmark can timestamp them without knowing their layout.
+struct sim_obj
+{
+    u64 born_ns;
+    u64 mark_ns;
+    u64 tag;
+} __attribute__((aligned(16)));
+
+static inline struct sim_obj *sim_obj(const void *ptr)
+{
+    return (struct sim_obj *)ptr - 1;
+}
+
+// Virtual clock
+extern u64 sim_clock_ns;
+extern struct task_struct *sim_current;
+
+// Lock order violations and failed lockdep_assert_held() seen so far
+extern int sim_lockdep_reports;
+
+// Hooks, called from the scheduler after each task step and each event,
+// and from kfree
+extern void (*sim_step_hook)(struct task_struct *task);
+extern void (*sim_event_hook)(struct sim_event *event, u64 cpu_ns);
+extern void (*sim_free_hook)(void *ptr);
+
+struct task_struct *sim_task_create(int (*threadfn)(void *data), void *data, const char *name);
+void sim_task_stop(struct task_struct *task);
+void sim_sleep_ns(u64 ns);
+void sim_wait(void *queue);
+void sim_wake(void *queue);
+void sim_run(void);
+
+void sim_lock_acquire(void *lock, struct sim_lock_class *lock_class, int trylock);
+void sim_lock_release(void *lock);
+int sim_lock_is_held(void *lock);
+void sim_lock_assert_held(void *lock, const char *name);
+
+void sim_rcu_read_lock(void);
+void sim_rcu_read_unlock(void);
+void sim_kfree_rcu(struct rcu_head *head, void *ptr);
+
+int sim_event_add(struct sim_event *event, u64 expires_ns, int rearm);
+int sim_event_del(struct sim_event *event);
+
+void sim_param_register(struct kernel_param *kp);
+int sim_param_set(const char *name, const char *val);
+
+void *sim_alloc(size_t size);
+void sim_free(void *ptr);
+
+#endif
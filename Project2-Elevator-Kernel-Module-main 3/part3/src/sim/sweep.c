@@ -0,0 +1,926 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "kshim.h"
+
+// The module is compiled as-is against the shims in include/linux, as in
+// bench. Its state is global, so every run is a forked child that starts
+// from the module as loaded and dies with whatever the run left behind.
+#include "../elevator.c"
+
+#include <linux/delay.h>
+#include <linux/kthread.h>
+
+// normally provided by syscalls.c in the kernel tree
+int (*STUB_start_elevator)(void) = NULL;
+int (*STUB_issue_request)(int, int, int) = NULL;
+int (*STUB_stop_elevator)(void) = NULL;
+int (*STUB_issue_requests)(const void __user *, int __user *, unsigned int) = NULL;
+
+#define MAX_AXES 16
+
+// Arrival patterns, as in bench
+enum pattern
+{
+    UNIFORM,
+    UP_PEAK,
+    DOWN_PEAK,
+    LUNCH,
+    DAY
+};
+
+static const char *pattern_names[] = {"uniform", "up", "down", "lunch", "day"};
+
+enum sort_key
+{
+    BY_MEAN,
+    BY_P99,
+    BY_THROUGHPUT
+};
+
+static const char *sort_names[] = {"mean", "p99", "throughput"};
+
+// One module parameter and the values it takes. The configurations are
+// every combination of one value per axis.
+struct axis
+{
+    const char *name;
+    char **values;
+    int count;
+};
+
+struct sweep_config
+{
+    long passengers;
+    double rate_per_hour;
+    u64 seed;
+    int replicas;
+    int workers;
+    int mix[4];
+    enum pattern pattern;
+    enum sort_key sort;
+    int top;
+};
+
+// What a run reports back, written by the child into memory shared with
+// the parent. status stays 0 unless the child got as far as the report.
+struct run_result
+{
+    int status;
+    int worker;
+    long completed;
+    long rejected;
+    double wait_sum;
+    double p99_wait;
+    double max_wait;
+    double trip_sum;
+    double throughput;
+    double wall_s;
+};
+
+// A run's figures summed over the seeds of its configuration
+struct config_summary
+{
+    int config;
+    int runs;
+    long completed;
+    double wait_sum;
+    double mean_wait;
+    double wait_sd;
+    double p99_wait;
+    double max_wait;
+    double mean_trip;
+    double throughput;
+};
+
+// A worker's share of the runs. The owner takes runs off the back and
+// idle workers steal them off the front, under the deque's lock, which is
+// held for far less time than a run takes.
+struct worker
+{
+    pthread_t thread;
+    int id;
+    pthread_mutex_t lock;
+    int *runs;
+    int head;
+    int tail;
+    u64 rng;
+    long done;
+    long stolen;
+};
+
+static struct sweep_config config = {
+    .passengers = 5000,
+    .rate_per_hour = 600.0,
+    .seed = 1,
+    .replicas = 3,
+    .mix = {1, 1, 1, 1},
+    .top = 20,
+};
+
+static struct axis axes[MAX_AXES];
+static int num_axes;
+static int num_configs;
+static int num_runs;
+static struct run_result *results;
+static struct worker *workers;
+static FILE *csv;
+static pthread_mutex_t csv_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// only ever touched by a forked child
+static u64 rng_state;
+static long issued;
+static long rejected;
+static long completed;
+static u64 *waits;
+static double wait_sum;
+static double trip_sum;
+
+/*===========================================================================*/
+/*=============================Random Functions==============================*/
+/*===========================================================================*/
+
+// Drawn in the same order as bench, so bench -s replays any run in full
+
+static u64 rng_next(u64 *state)
+{
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rnd_unit(void)
+{
+    return (rng_next(&rng_state) >> 11) * 0x1.0p-53;
+}
+
+static int rnd(int min, int max)
+{
+    return rng_next(&rng_state) % (max - min + 1) + min;
+}
+
+static void lobby_trip(int lobby_start, int *start, int *dest)
+{
+    int other = rnd(2, num_floors);
+
+    *start = lobby_start ? 1 : other;
+    *dest = lobby_start ? other : 1;
+}
+
+static void pick_floors(int *start, int *dest)
+{
+    enum pattern pattern = config.pattern;
+    int hour = sim_clock_ns / NSEC_PER_SEC / 3600 % 24;
+    double pick = rnd_unit();
+
+    if (pattern == DAY)
+    {
+        pattern = hour >= 7 && hour < 10 ? UP_PEAK : hour >= 11 && hour < 14 ? LUNCH :
+                  hour >= 16 && hour < 19 ? DOWN_PEAK : UNIFORM;
+    }
+
+    if (pattern == UP_PEAK && pick < 0.85)
+    {
+        lobby_trip(1, start, dest);
+        return;
+    }
+    if (pattern == DOWN_PEAK && pick < 0.85)
+    {
+        lobby_trip(0, start, dest);
+        return;
+    }
+    if (pattern == LUNCH && pick < 0.90)
+    {
+        lobby_trip(pick < 0.45, start, dest);
+        return;
+    }
+
+    *start = rnd(1, num_floors);
+    do
+    {
+        *dest = rnd(1, num_floors);
+    } while (*dest == *start);
+}
+
+static int rnd_type(void)
+{
+    int total = config.mix[0] + config.mix[1] + config.mix[2] + config.mix[3];
+    int pick = rnd(0, total - 1);
+    int type = 0;
+
+    while (pick >= config.mix[type])
+    {
+        pick -= config.mix[type++];
+    }
+    return type;
+}
+
+/*===========================================================================*/
+/*=============================Traffic Functions=============================*/
+/*===========================================================================*/
+
+static int riders_on_board(void)
+{
+    int riders = 0;
+
+    for (int i = 0; i < num_cars; ++i)
+    {
+        riders += elevators[i].num_passengers;
+    }
+    return riders;
+}
+
+static int producer_thread(void *data)
+{
+    struct Passenger *passenger;
+    double gap_seconds;
+    int type, start, dest;
+
+    for (long i = 0; i < config.passengers; ++i)
+    {
+        gap_seconds = -log(1.0 - rnd_unit()) * 3600.0 / config.rate_per_hour;
+        sim_sleep_ns((u64)(gap_seconds * NSEC_PER_SEC));
+
+        type = rnd_type();
+        pick_floors(&start, &dest);
+        if (issue_request(start, dest, type) == 0)
+        {
+            // only passengers are tagged, so the free hook can tell them
+            // from everything else the module frees
+            passenger = list_last_entry(&floors.floor_lists[start - 1], struct Passenger, list);
+            sim_obj(passenger)->tag = 1;
+            issued++;
+        }
+        else
+        {
+            rejected++;
+        }
+    }
+
+    while (atomic_read(&floors.num_passengers_waiting) > 0 || riders_on_board() > 0)
+    {
+        ssleep(1);
+    }
+    stop_elevator();
+
+    return 0;
+}
+
+static void sweep_free(void *ptr)
+{
+    struct Passenger *passenger = ptr;
+
+    if (!sim_obj(ptr)->tag || !passenger->boarded)
+    {
+        return;
+    }
+
+    waits[completed++] = passenger->boarded - passenger->issued;
+    wait_sum += (double)(passenger->boarded - passenger->issued) / NSEC_PER_SEC;
+    trip_sum += (double)(sim_clock_ns - passenger->issued) / NSEC_PER_SEC;
+}
+
+/*===========================================================================*/
+/*===============================Run Functions===============================*/
+/*===========================================================================*/
+
+// value of axis a in configuration c, the last axis varying fastest
+static const char *axis_value(int config_index, int a)
+{
+    for (int i = num_axes - 1; i > a; --i)
+    {
+        config_index /= axes[i].count;
+    }
+    return axes[a].values[config_index % axes[a].count];
+}
+
+// the parameters that vary, e.g. "policy=look num_cars=2"
+static void config_label(int config_index, char *buffer, size_t size)
+{
+    size_t len = 0;
+
+    buffer[0] = '\0';
+    for (int a = 0; a < num_axes && len < size; ++a)
+    {
+        if (axes[a].count > 1)
+        {
+            len += snprintf(buffer + len, size - len, "%s%s=%s", len ? " " : "", axes[a].name,
+                            axis_value(config_index, a));
+        }
+    }
+    if (!buffer[0])
+    {
+        snprintf(buffer, size, "defaults");
+    }
+}
+
+static u64 run_seed(int run)
+{
+    // the same seeds for every configuration, so they all see the same
+    // riders and differ only by the parameters
+    return config.seed + run % config.replicas;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64 *)a;
+    u64 y = *(const u64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+// runs in the child, never returns
+static void run_child(int run)
+{
+    struct run_result *result = &results[run];
+    int config_index = run / config.replicas;
+    double sim_hours;
+
+    for (int a = 0; a < num_axes; ++a)
+    {
+        if (sim_param_set(axes[a].name, axis_value(config_index, a)) != 0)
+        {
+            _exit(1);
+        }
+    }
+
+    rng_state = run_seed(run) ? run_seed(run) : 1;
+    waits = malloc(sizeof(u64) * (config.passengers + 1));
+    if (!waits)
+    {
+        _exit(1);
+    }
+
+    sim_free_hook = sweep_free;
+    if (elevator_init() != 0)
+    {
+        _exit(1);
+    }
+    start_elevator();
+    sim_task_create(producer_thread, NULL, "producer");
+    sim_run();
+    sim_free_hook = NULL;
+
+    sim_hours = (double)sim_clock_ns / NSEC_PER_SEC / 3600.0;
+    result->completed = completed;
+    result->rejected = rejected;
+    result->wait_sum = wait_sum;
+    result->trip_sum = trip_sum;
+    result->throughput = sim_hours > 0 ? completed / sim_hours : 0.0;
+    if (completed)
+    {
+        qsort(waits, completed, sizeof(u64), compare_u64);
+        result->p99_wait = (double)waits[(long)ceil(0.99 * completed) - 1] / NSEC_PER_SEC;
+        result->max_wait = (double)waits[completed - 1] / NSEC_PER_SEC;
+    }
+    result->status = 1;
+
+    elevator_exit();
+    _exit(0);
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_csv(int run)
+{
+    struct run_result *result = &results[run];
+    int config_index = run / config.replicas;
+
+    pthread_mutex_lock(&csv_lock);
+    fprintf(csv, "%d,%llu,%s", config_index, run_seed(run), result->status == 1 ? "ok" : "failed");
+    for (int a = 0; a < num_axes; ++a)
+    {
+        // quoted, trip_targets has commas of its own
+        fprintf(csv, ",\"%s\"", axis_value(config_index, a));
+    }
+    fprintf(csv, ",%ld,%ld,%.3f,%.3f,%.3f,%.3f,%.1f,%.3f,%d\n", result->completed, result->rejected,
+            result->completed ? result->wait_sum / result->completed : 0.0, result->p99_wait,
+            result->max_wait, result->completed ? result->trip_sum / result->completed : 0.0,
+            result->throughput, result->wall_s, result->worker);
+    pthread_mutex_unlock(&csv_lock);
+}
+
+static void execute_run(struct worker *worker, int run)
+{
+    double start = wall_seconds();
+    pid_t pid, reaped;
+    int status;
+
+    fflush(NULL);
+    pid = fork();
+    if (pid == 0)
+    {
+        run_child(run);
+    }
+
+    // a failed fork, a child that died or one that cannot be reaped counts
+    // as a failed run
+    reaped = -1;
+    if (pid > 0)
+    {
+        do
+        {
+            reaped = waitpid(pid, &status, 0);
+        } while (reaped < 0 && errno == EINTR);
+    }
+    if (reaped < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        results[run].status = -1;
+    }
+
+    results[run].worker = worker->id;
+    results[run].wall_s = wall_seconds() - start;
+    worker->done++;
+    if (csv)
+    {
+        write_csv(run);
+    }
+}
+
+/*===========================================================================*/
+/*===============================Pool Functions==============================*/
+/*===========================================================================*/
+
+static int take_own(struct worker *worker)
+{
+    int run = -1;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->tail > worker->head)
+    {
+        run = worker->runs[--worker->tail];
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return run;
+}
+
+// Tries every other worker once, starting from a random one. No run is
+// ever queued after the start, so finding them all empty means there is
+// nothing left to do.
+static int steal(struct worker *thief)
+{
+    int first = rng_next(&thief->rng) % config.workers;
+    struct worker *victim;
+    int run = -1;
+
+    for (int i = 0; i < config.workers && run < 0; ++i)
+    {
+        victim = &workers[(first + i) % config.workers];
+        if (victim == thief)
+        {
+            continue;
+        }
+        pthread_mutex_lock(&victim->lock);
+        if (victim->tail > victim->head)
+        {
+            run = victim->runs[victim->head++];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    if (run >= 0)
+    {
+        thief->stolen++;
+    }
+
+    return run;
+}
+
+static void *worker_thread(void *data)
+{
+    struct worker *worker = data;
+    int run;
+
+    while ((run = take_own(worker)) >= 0 || (run = steal(worker)) >= 0)
+    {
+        execute_run(worker, run);
+    }
+
+    return NULL;
+}
+
+// Deals the runs out in contiguous blocks, so each worker starts with a
+// few whole configurations. Configurations that run long, like a single
+// car at a rate it cannot carry, are then left to the others to steal from.
+static int start_workers(int *order)
+{
+    for (int i = 0; i < config.workers; ++i)
+    {
+        workers[i].id = i;
+        workers[i].runs = order;
+        workers[i].head = (long)num_runs * i / config.workers;
+        workers[i].tail = (long)num_runs * (i + 1) / config.workers;
+        workers[i].rng = config.seed + i + 1;
+        pthread_mutex_init(&workers[i].lock, NULL);
+    }
+    for (int i = 0; i < config.workers; ++i)
+    {
+        if (pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
+/*=============================Report Functions==============================*/
+/*===========================================================================*/
+
+static void summarize_config(struct config_summary *summary, int config_index)
+{
+    struct run_result *result;
+    double trip_sum = 0, square_sum = 0, mean;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->config = config_index;
+    for (int r = 0; r < config.replicas; ++r)
+    {
+        result = &results[config_index * config.replicas + r];
+        if (result->status != 1 || !result->completed)
+        {
+            continue;
+        }
+        mean = result->wait_sum / result->completed;
+        summary->runs++;
+        summary->completed += result->completed;
+        summary->wait_sum += result->wait_sum;
+        square_sum += mean * mean;
+        summary->p99_wait += result->p99_wait;
+        summary->max_wait = max(summary->max_wait, result->max_wait);
+        summary->throughput += result->throughput;
+        trip_sum += result->trip_sum;
+    }
+    if (!summary->runs)
+    {
+        return;
+    }
+
+    summary->mean_wait = summary->wait_sum / summary->completed;
+    summary->p99_wait /= summary->runs;
+    summary->throughput /= summary->runs;
+    summary->mean_trip = trip_sum / summary->completed;
+    // spread of the per-seed means, to judge whether two ranks differ
+    summary->wait_sd = 0;
+    if (summary->runs > 1)
+    {
+        summary->wait_sd = sqrt(max((square_sum - summary->runs * summary->mean_wait * summary->mean_wait) /
+                                        (summary->runs - 1), 0.0));
+    }
+}
+
+static int compare_summary(const void *a, const void *b)
+{
+    const struct config_summary *x = a;
+    const struct config_summary *y = b;
+    double dx, dy;
+
+    // configurations where every run failed go last
+    if (!x->runs || !y->runs)
+    {
+        return !x->runs - !y->runs;
+    }
+
+    dx = config.sort == BY_P99 ? x->p99_wait : config.sort == BY_THROUGHPUT ? -x->throughput : x->mean_wait;
+    dy = config.sort == BY_P99 ? y->p99_wait : config.sort == BY_THROUGHPUT ? -y->throughput : y->mean_wait;
+    if (dx != dy)
+    {
+        return (dx > dy) - (dx < dy);
+    }
+    if (x->mean_wait != y->mean_wait)
+    {
+        return (x->mean_wait > y->mean_wait) - (x->mean_wait < y->mean_wait);
+    }
+    return x->config - y->config;
+}
+
+static void print_table(struct config_summary *summaries)
+{
+    int shown = config.top > 0 && config.top < num_configs ? config.top : num_configs;
+    char label[512];
+
+    printf("%4s %10s %7s %10s %10s %10s %13s %5s  %s\n", "rank", "mean wait", "+/-", "p99 wait",
+           "max wait", "mean trip", "passengers/h", "runs", "configuration");
+    for (int i = 0; i < shown; ++i)
+    {
+        config_label(summaries[i].config, label, sizeof(label));
+        if (!summaries[i].runs)
+        {
+            printf("%4d %10s %7s %10s %10s %10s %13s %5d  %s\n", i + 1, "failed", "", "", "", "", "", 0,
+                   label);
+            continue;
+        }
+        printf("%4d %8.1f s %5.1f s %8.1f s %8.1f s %8.1f s %13.1f %5d  %s\n", i + 1,
+               summaries[i].mean_wait, summaries[i].wait_sd, summaries[i].p99_wait,
+               summaries[i].max_wait, summaries[i].mean_trip, summaries[i].throughput,
+               summaries[i].runs, label);
+    }
+    if (shown < num_configs)
+    {
+        printf(" ... %d more, -t 0 shows them all\n", num_configs - shown);
+    }
+}
+
+// the bench command that replays the first seed of a configuration
+static void print_replay(int config_index)
+{
+    printf("./bench -n %ld -r %g -s %llu -m %d,%d,%d,%d -P %s", config.passengers, config.rate_per_hour,
+           config.seed, config.mix[0], config.mix[1], config.mix[2], config.mix[3],
+           pattern_names[config.pattern]);
+    for (int a = 0; a < num_axes; ++a)
+    {
+        printf(" -o %s=%s", axes[a].name, axis_value(config_index, a));
+    }
+    printf("\n");
+}
+
+/*===========================================================================*/
+/*==============================Option Functions=============================*/
+/*===========================================================================*/
+
+// adds value to the axis of name, which repeating a parameter extends
+static int add_value(const char *name, const char *value)
+{
+    struct axis *axis = NULL;
+    char **values;
+
+    for (int a = 0; a < num_axes; ++a)
+    {
+        if (strcmp(axes[a].name, name) == 0)
+        {
+            axis = &axes[a];
+        }
+    }
+    if (!axis)
+    {
+        if (num_axes == MAX_AXES)
+        {
+            return -1;
+        }
+        axis = &axes[num_axes++];
+        axis->name = strdup(name);
+    }
+
+    // a bad value would only fail every run of it, so check it up front
+    if (sim_param_set(name, value) != 0)
+    {
+        printf("invalid module parameter %s=%s\n", name, value);
+        return -1;
+    }
+
+    values = realloc(axis->values, sizeof(char *) * (axis->count + 1));
+    if (!values)
+    {
+        return -1;
+    }
+    axis->values = values;
+    axis->values[axis->count++] = strdup(value);
+
+    return 0;
+}
+
+// name=v1,v2,... or, with whole set, name=value taken as it is
+static int parse_param(char *arg, int whole)
+{
+    char *value = strchr(arg, '=');
+    char *next;
+
+    if (!value)
+    {
+        return -1;
+    }
+    *value++ = '\0';
+    if (whole)
+    {
+        return add_value(arg, value);
+    }
+
+    for (; value; value = next)
+    {
+        next = strchr(value, ',');
+        if (next)
+        {
+            *next++ = '\0';
+        }
+        if (add_value(arg, value) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-n passengers] [-r arrivals_per_hour] [-s seed] [-S seeds] [-m P,L,B,V] [-P uniform|up|down|lunch|day] [-j workers] [-k mean|p99|throughput] [-t top] [-c csv_file] [-o param=v1,v2,...]... [-O param=value]...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    struct config_summary *summaries;
+    double wall_start, wall_time;
+    long stolen = 0, failed = 0;
+    const char *csv_path = NULL;
+    int *order;
+    int opt;
+
+    config.workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+    while ((opt = getopt(argc, argv, "n:r:s:S:m:P:j:k:t:c:o:O:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.passengers = atol(optarg);
+            break;
+        case 'r':
+            config.rate_per_hour = atof(optarg);
+            break;
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'S':
+            config.replicas = atoi(optarg);
+            break;
+        case 'm':
+            if (sscanf(optarg, "%d,%d,%d,%d", &config.mix[0], &config.mix[1], &config.mix[2],
+                       &config.mix[3]) != 4)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'P':
+            for (opt = UNIFORM; opt <= DAY && strcmp(optarg, pattern_names[opt]) != 0; ++opt)
+            {
+            }
+            if (opt > DAY)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            config.pattern = opt;
+            break;
+        case 'j':
+            config.workers = atoi(optarg);
+            break;
+        case 'k':
+            for (opt = BY_MEAN; opt <= BY_THROUGHPUT && strcmp(optarg, sort_names[opt]) != 0; ++opt)
+            {
+            }
+            if (opt > BY_THROUGHPUT)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            config.sort = opt;
+            break;
+        case 't':
+            config.top = atoi(optarg);
+            break;
+        case 'c':
+            csv_path = optarg;
+            break;
+        case 'o':
+        case 'O':
+            if (parse_param(optarg, opt == 'O') != 0)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (config.passengers < 0 || config.rate_per_hour <= 0 || config.replicas < 1 || config.workers < 1 ||
+        config.mix[0] < 0 || config.mix[1] < 0 || config.mix[2] < 0 || config.mix[3] < 0 ||
+        config.mix[0] + config.mix[1] + config.mix[2] + config.mix[3] == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    num_configs = 1;
+    for (int a = 0; a < num_axes; ++a)
+    {
+        if (num_configs > INT_MAX / axes[a].count)
+        {
+            printf("too many configurations\n");
+            return 1;
+        }
+        num_configs *= axes[a].count;
+    }
+    if (num_configs > INT_MAX / config.replicas)
+    {
+        printf("too many runs\n");
+        return 1;
+    }
+    num_runs = num_configs * config.replicas;
+    config.workers = min(config.workers, num_runs);
+
+    results = mmap(NULL, sizeof(struct run_result) * num_runs, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    workers = calloc(config.workers, sizeof(struct worker));
+    order = malloc(sizeof(int) * num_runs);
+    summaries = malloc(sizeof(struct config_summary) * num_configs);
+    if (results == MAP_FAILED || !workers || !order || !summaries)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < num_runs; ++i)
+    {
+        order[i] = i;
+    }
+
+    if (csv_path)
+    {
+        csv = fopen(csv_path, "w");
+        if (!csv)
+        {
+            perror(csv_path);
+            return 1;
+        }
+        fprintf(csv, "config,seed,status");
+        for (int a = 0; a < num_axes; ++a)
+        {
+            fprintf(csv, ",%s", axes[a].name);
+        }
+        fprintf(csv, ",serviced,rejected,mean_wait_s,p99_wait_s,max_wait_s,mean_trip_s,passengers_per_h,wall_s,worker\n");
+    }
+
+    printf("%d configurations x %d seeds from %llu, %ld passengers at %g/h (%s), on %d workers\n",
+           num_configs, config.replicas, (unsigned long long)config.seed, config.passengers,
+           config.rate_per_hour, pattern_names[config.pattern], config.workers);
+    for (int a = 0; a < num_axes; ++a)
+    {
+        if (axes[a].count == 1)
+        {
+            printf("fixed: %s=%s\n", axes[a].name, axes[a].values[0]);
+        }
+    }
+    fflush(stdout);
+
+    wall_start = wall_seconds();
+    if (start_workers(order) != 0)
+    {
+        printf("could not start the workers\n");
+        return 1;
+    }
+    for (int i = 0; i < config.workers; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+        stolen += workers[i].stolen;
+    }
+    wall_time = wall_seconds() - wall_start;
+
+    for (int i = 0; i < num_runs; ++i)
+    {
+        failed += results[i].status != 1;
+    }
+    for (int c = 0; c < num_configs; ++c)
+    {
+        summarize_config(&summaries[c], c);
+    }
+    qsort(summaries, num_configs, sizeof(struct config_summary), compare_summary);
+
+    printf("%d runs in %.2f s (%.1f runs/s), %ld stolen, %ld failed\n\n", num_runs, wall_time,
+           wall_time > 0 ? num_runs / wall_time : 0.0, stolen, failed);
+    printf("ranked by %s%s over the seeds of each configuration\n", sort_names[config.sort],
+           config.sort == BY_THROUGHPUT ? "" : " wait");
+    print_table(summaries);
+    printf("\nbest, replayed by\n");
+    print_replay(summaries[0].config);
+
+    if (csv)
+    {
+        fclose(csv);
+    }
+    munmap(results, sizeof(struct run_result) * num_runs);
+    free(summaries);
+    free(order);
+    free(workers);
+
+    return 0;
+}
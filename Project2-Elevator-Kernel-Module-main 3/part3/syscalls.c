@@ -7,9 +7,11 @@
 int (*STUB_start_elevator)(void) = NULL;
 int (*STUB_issue_request)(int, int, int) = NULL;
 int (*STUB_stop_elevator)(void) = NULL;
+int (*STUB_issue_requests)(const void __user *, int __user *, unsigned int) = NULL;
 EXPORT_SYMBOL(STUB_start_elevator);
 EXPORT_SYMBOL(STUB_issue_request);
 EXPORT_SYMBOL(STUB_stop_elevator);
+EXPORT_SYMBOL(STUB_issue_requests);
 
 SYSCALL_DEFINE0(start_elevator)
 {
@@ -23,7 +25,7 @@ SYSCALL_DEFINE0(start_elevator)
 SYSCALL_DEFINE3(issue_request, int, start_floor, int, destination_floor, int, type)
 {
     printk(KERN_NOTICE "Inside SYSCALL_DEFINE3 block. %s: Your ints are %d, %d, %d\n"
-	, __FUNCTION__, st>
+	, __FUNCTION__, start_floor, destination_floor, type);
     if (STUB_issue_request != NULL)
         return STUB_issue_request(start_floor, destination_floor, type);
     else
@@ -38,3 +40,12 @@ SYSCALL_DEFINE0(stop_elevator)
     else
         return -ENOSYS;
 }
+
+SYSCALL_DEFINE3(issue_requests, const void __user *, requests, int __user *, statuses, unsigned int, count)
+{
+    printk(KERN_NOTICE "Inside SYSCALL_DEFINE3 batch block. %s: %u requests\n", __FUNCTION__, count);
+    if (STUB_issue_requests != NULL)
+        return STUB_issue_requests(requests, statuses, count);
+    else
+        return -ENOSYS;
+}